@@ -1,20 +1,66 @@
 #include "ast.h"
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
 
 auto ast::Statement::token_literal() const -> std::string
 {
-  return token.literal;
+  return std::string(token.literal);
 }
 
 auto ast::Statement::type() const -> Node { return Node::Statement; }
 auto ast::Expression::token_literal() const -> std::string
 {
-  return token.literal;
+  return std::string(token.literal);
 }
 
-auto ast::Expression::to_string() const -> std::string { return token.literal; }
+auto ast::Expression::to_string() const -> std::string
+{
+  return std::string(token.literal);
+}
 
 auto ast::Expression::type() const -> Node { return Node::Expression; }
 
+auto ast::Scope::declare(Symbol name) -> std::size_t
+{
+  auto itr = slots.find(name);
+  if (itr != slots.end()) {
+    return itr->second;
+  }
+  return slots.emplace(name, slots.size()).first->second;
+}
+
+auto ast::Scope::find(Symbol name) const -> std::size_t
+{
+  auto itr = slots.find(name);
+  return itr != slots.end() ? itr->second : UNRESOLVED_SLOT;
+}
+
+auto ast::Arena::allocate(std::size_t size, std::size_t alignment) -> void *
+{
+  void *pointer = cursor;
+  if (std::align(alignment, size, pointer, remaining) == nullptr) {
+    // the tail of the current block is wasted, nodes are small enough for it
+    // not to matter
+    remaining = std::max(BLOCK_SIZE, size + alignment);
+    blocks.push_back(std::make_unique_for_overwrite<std::byte[]>(remaining));
+    pointer = blocks.back().get();
+    std::align(alignment, size, pointer, remaining);
+  }
+  cursor = static_cast<std::byte *>(pointer) + size;
+  remaining -= size;
+  return pointer;
+}
+
+ast::Arena::~Arena()
+{
+  for (auto node = nodes.rbegin(); node != nodes.rend(); node++) {
+    (*node)->~ASTNode();
+  }
+}
+
 auto ast::Program::token_literal() const -> std::string
 {
   if (!statements.empty()) {
@@ -39,7 +85,10 @@ auto ast::Program::operator==(const Program &other_program) const -> bool
 
 auto ast::Identifier::type() const -> Node { return Node::Identifier; }
 
-auto ast::Identifier::to_string() const -> std::string { return value; }
+auto ast::Identifier::to_string() const -> std::string
+{
+  return std::string(value);
+}
 
 auto ast::LetStatement::type() const -> Node { return Node::LetStatement; }
 
@@ -80,20 +129,23 @@ auto ast::Prefix::type() const -> Node { return Node::Prefix; }
 
 auto ast::Prefix::to_string() const -> std::string
 {
-  return "(" + operatr + right->to_string() + ")";
+  return "(" + std::string(operatr) + right->to_string() + ")";
 }
 
 auto ast::Infix::type() const -> Node { return Node::Infix; }
 
 auto ast::Infix::to_string() const -> std::string
 {
-  return "(" + left->to_string() + " " + operatr + " " + right->to_string() +
-         ")";
+  return "(" + left->to_string() + " " + std::string(operatr) + " " +
+         right->to_string() + ")";
 }
 
 auto ast::Boolean::type() const -> Node { return Node::Boolean; }
 
-auto ast::Boolean::to_string() const -> std::string { return token_literal(); }
+auto ast::Boolean::to_string() const -> std::string
+{
+  return value ? "verdadero" : "falso";
+}
 
 auto ast::Block::type() const -> Node { return Node::Block; }
 
@@ -147,10 +199,7 @@ auto ast::Call::to_string() const -> std::string
 
 auto ast::StringLiteral::type() const -> Node { return Node::StringLiteral; }
 
-auto ast::StringLiteral::to_string() const -> std::string
-{
-  return Expression::to_string();
-}
+auto ast::StringLiteral::to_string() const -> std::string { return value; }
 
 auto ast::Null::type() const -> Node { return Node::Null; }
 
@@ -169,9 +218,10 @@ auto ast::AssignStatement::to_string() const -> std::string
 void ast::Programs_Guard::push_back(Program *prog) { programs.push_back(prog); }
 
 auto ast::Programs_Guard::new_program(
-    const std::vector<Statement *> &statements) -> Program *
+    const std::vector<Statement *> &statements, std::unique_ptr<Arena> nodes)
+    -> Program *
 {
-  auto *prog = new Program(statements);
+  auto *prog = new Program(statements, std::move(nodes));
   programs.push_back(prog);
   return prog;
 }
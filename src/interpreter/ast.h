@@ -1,10 +1,28 @@
 #ifndef AST_H
 #define AST_H
+#include "source.h"
+#include "symbol.h"
 #include "token.h"
+#include <array>
 #include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <new>
 #include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
+namespace obj {
+class Builtin;
+class String;
+} // namespace obj
+
+class JitFunction;
+
 namespace ast {
 enum class Node {
   AssignStatement,
@@ -28,6 +46,49 @@ enum class Node {
   StringLiteral
 };
 
+// resolved by the parser so the engines never compare operator strings
+enum class Operator : std::uint8_t {
+  PLUS,
+  MINUS,
+  MULTIPLICATION,
+  DIVISION,
+  EQ,
+  NOT_EQ,
+  LT,
+  GT,
+  NEGATION
+};
+
+static constexpr std::array<NameValuePair<Operator>, 9> operators_enums_strings{
+    {{Operator::PLUS, "+"},
+     {Operator::MINUS, "-"},
+     {Operator::MULTIPLICATION, "*"},
+     {Operator::DIVISION, "/"},
+     {Operator::EQ, "=="},
+     {Operator::NOT_EQ, "!="},
+     {Operator::LT, "<"},
+     {Operator::GT, ">"},
+     {Operator::NEGATION, "!"}}};
+
+inline constexpr std::size_t UNRESOLVED_SLOT =
+    std::numeric_limits<std::size_t>::max();
+
+// Variables of a function call, or of the global environment, laid out as
+// slots. Blocks don't open scopes, so only procedimientos get one.
+class Scope {
+  std::unordered_map<Symbol, std::size_t> slots;
+  // set when a procedimiento is created in this scope, so an environment with
+  // this layout may outlive the call that made it
+  bool captured = false;
+
+public:
+  auto declare(Symbol name) -> std::size_t;
+  [[nodiscard]] auto find(Symbol name) const -> std::size_t;
+  [[nodiscard]] auto size() const -> std::size_t { return slots.size(); }
+  void mark_captured() { captured = true; }
+  [[nodiscard]] auto is_captured() const -> bool { return captured; }
+};
+
 class ASTNode {
 public:
   [[nodiscard]] virtual auto token_literal() const -> std::string = 0;
@@ -41,6 +102,43 @@ public:
   auto operator=(ASTNode &&) -> ASTNode & = delete;
 };
 
+// Bump allocator for every node of one parse. Nodes don't own their
+// children: the arena runs all their destructors and frees its blocks in one
+// go when it dies.
+class Arena {
+  static constexpr std::size_t BLOCK_SIZE = 64UL * 1024UL;
+
+  std::vector<std::unique_ptr<std::byte[]>> blocks;
+  std::byte *cursor = nullptr;
+  std::size_t remaining = 0;
+  std::vector<ASTNode *> nodes;
+  // the text the nodes' tokens and names point into
+  std::shared_ptr<const SourceBuffer> source;
+
+  auto allocate(std::size_t size, std::size_t alignment) -> void *;
+
+public:
+  Arena() = default;
+  Arena(const Arena &) = delete;
+  auto operator=(const Arena &) -> Arena & = delete;
+  Arena(Arena &&) = delete;
+  auto operator=(Arena &&) -> Arena & = delete;
+  ~Arena();
+
+  template <class T, class... Args> auto make(Args &&...args) -> T *
+  {
+    auto *node = new (allocate(sizeof(T), alignof(T)))
+        T(std::forward<Args>(args)...);
+    nodes.push_back(node);
+    return node;
+  }
+  [[nodiscard]] auto node_count() const -> std::size_t { return nodes.size(); }
+  void keep_alive(std::shared_ptr<const SourceBuffer> buffer)
+  {
+    source = std::move(buffer);
+  }
+};
+
 class Statement : public ASTNode {
 public:
   Token token;
@@ -67,29 +165,41 @@ public:
   auto operator=(const Program &) -> Program & = delete;
 
   std::vector<Statement *> statements;
-
-  explicit Program(const std::vector<Statement *> &statements)
-      : statements(statements) {}
+  // global scope the identifiers were last resolved against
+  const Scope *resolved_scope = nullptr;
+  // set once the Optimizer has folded the program's literals
+  bool optimized = false;
+  // where the statements were allocated, when the program owns them
+  std::unique_ptr<Arena> arena;
+
+  explicit Program(const std::vector<Statement *> &stmts)
+      : statements(stmts) {}
+  Program(const std::vector<Statement *> &stmts,
+          std::unique_ptr<Arena> nodes)
+      : statements(stmts), arena(std::move(nodes)) {}
   [[nodiscard]] auto type() const -> Node override { return Node::Program; }
   [[nodiscard]] auto token_literal() const -> std::string override;
   [[nodiscard]] auto to_string() const -> std::string override;
 
   auto operator==(const Program &other_program) const -> bool;
-
-  ~Program() final
-  {
-    for (auto *statement : statements) {
-      delete statement;
-    }
-  }
 };
 
 class Identifier : public Expression {
 public:
-  const std::string value;
+  // a view into the program's SourceBuffer
+  const std::string_view value;
+  const Symbol symbol = 0;
+  // filled in by the Resolver: how many procedimientos out the variable
+  // lives and its slot there
+  std::size_t depth = 0;
+  std::size_t slot = UNRESOLVED_SLOT;
+  // what a read of an unset global gives, looked up by the evaluator the
+  // first time; assigning the name fills the slot, which is read first
+  obj::Builtin *builtin = nullptr;
+  bool builtin_cached = false;
   Identifier() = default;
-  Identifier(const Token &tkn, const std::string &val)
-      : Expression(tkn), value(val) {}
+  Identifier(const Token &tkn, std::string_view val)
+      : Expression(tkn), value(val), symbol(intern_symbol(val)) {}
   [[nodiscard]] auto type() const -> Node override;
   [[nodiscard]] auto to_string() const -> std::string override;
 };
@@ -105,17 +215,13 @@ public:
       : Statement(token), name(name), value(value) {}
   [[nodiscard]] auto type() const -> Node override;
   [[nodiscard]] auto to_string() const -> std::string override;
-
-  ~LetStatement() final
-  {
-    delete name;
-    delete value;
-  }
 };
 
 class ReturnStatement final : public Statement {
 public:
   Expression *return_value;
+  // set by the resolver when the value is a call that ends its procedimiento
+  bool tail_call = false;
   ReturnStatement() = default;
   explicit ReturnStatement(const Token &tkn)
       : Statement(tkn), return_value(nullptr) {}
@@ -123,8 +229,6 @@ public:
       : Statement(tkn), return_value(rtn_val) {}
   [[nodiscard]] auto type() const -> Node override;
   [[nodiscard]] auto to_string() const -> std::string override;
-
-  ~ReturnStatement() final { delete return_value; }
 };
 
 class ExpressionStatement final : public Statement {
@@ -137,8 +241,6 @@ public:
       : Statement(tkn), expression(exp) {}
   [[nodiscard]] auto type() const -> Node override;
   [[nodiscard]] auto to_string() const -> std::string override;
-
-  ~ExpressionStatement() final { delete expression; }
 };
 
 class Integer : public Expression {
@@ -152,36 +254,49 @@ public:
 
 class Prefix final : public Expression {
 public:
-  const std::string operatr;
+  const std::string_view operatr;
+  const Operator op;
   Expression *right;
-  Prefix(const Token &tkn, const std::string &optr)
-      : Expression(tkn), operatr(optr), right(nullptr) {}
-  Prefix(const Token &tkn, const std::string &optr, Expression *exp)
-      : Expression(tkn), operatr(optr), right(exp) {}
+  Prefix(const Token &tkn, std::string_view optr, Operator opr)
+      : Expression(tkn), operatr(optr), op(opr), right(nullptr) {}
+  Prefix(const Token &tkn, std::string_view optr, Operator opr,
+         Expression *exp)
+      : Expression(tkn), operatr(optr), op(opr), right(exp) {}
   [[nodiscard]] auto type() const -> Node override;
   [[nodiscard]] auto to_string() const -> std::string override;
+};
 
-  ~Prefix() final { delete right; }
+// What the tree-walking evaluator has seen an Infix's operands be. It starts
+// UNSEEN, becomes the integer version of its operator the first time both
+// are integers, and stays GENERIC once they aren't.
+enum class InfixState : std::uint8_t {
+  UNSEEN,
+  INTEGER_PLUS,
+  INTEGER_MINUS,
+  INTEGER_MULTIPLICATION,
+  INTEGER_DIVISION,
+  INTEGER_LT,
+  INTEGER_GT,
+  INTEGER_EQ,
+  INTEGER_NOT_EQ,
+  GENERIC
 };
 
 class Infix final : public Expression {
 public:
   Expression *right;
   Expression *left;
-  const std::string operatr;
-  Infix(const Token &tkn, Expression *lft, const std::string &optr)
-      : Expression(tkn), right(nullptr), left(lft), operatr(optr) {}
-  Infix(const Token &tkn, Expression *lft, const std::string &optr,
-        Expression *rht)
-      : Expression(tkn), right(rht), left(lft), operatr(optr) {}
+  const std::string_view operatr;
+  const Operator op;
+  InfixState state = InfixState::UNSEEN;
+  Infix(const Token &tkn, Expression *lft, std::string_view optr,
+        Operator opr)
+      : Expression(tkn), right(nullptr), left(lft), operatr(optr), op(opr) {}
+  Infix(const Token &tkn, Expression *lft, std::string_view optr,
+        Operator opr, Expression *rht)
+      : Expression(tkn), right(rht), left(lft), operatr(optr), op(opr) {}
   [[nodiscard]] auto type() const -> Node override;
   [[nodiscard]] auto to_string() const -> std::string override;
-
-  ~Infix() final
-  {
-    delete right;
-    delete left;
-  }
 };
 
 class Boolean : public Expression {
@@ -196,35 +311,26 @@ public:
 class Block final : public Statement {
 public:
   std::vector<Statement *> statements;
+  // set by the JIT when this is the body of a procedimiento it has seen
+  std::shared_ptr<JitFunction> native;
   Block(const Token &tkn, const std::vector<Statement *> &statements)
       : Statement(tkn), statements(statements) {}
   [[nodiscard]] auto type() const -> Node override;
   [[nodiscard]] auto to_string() const -> std::string override;
-
-  ~Block() final
-  {
-    for (auto *statement : statements) {
-      delete statement;
-    }
-  }
 };
 
 class LoopStatement final : public Statement {
 public:
   Expression *condition;
   Block *repeat;
+  // times the body ran and jumped back to the condition, for hotness checks
+  std::size_t back_edges = 0;
   explicit LoopStatement(const Token &tkn)
       : Statement(tkn), condition(nullptr), repeat(nullptr) {}
   LoopStatement(const Token &tkn, Expression *cond, Block *rept)
       : Statement(tkn), condition(cond), repeat(rept){}
   [[nodiscard]] auto type() const -> Node final { return Node::Loop; }
   [[nodiscard]] auto to_string() const -> std::string final;
-
-  ~LoopStatement() final
-  {
-    delete condition;
-    delete repeat;
-  }
 };
 
 class If final : public Expression {
@@ -242,19 +348,13 @@ public:
       : Expression(tkn), condition(cond), consequence(cons), alternative(alt) {}
   [[nodiscard]] auto type() const -> Node override { return Node::If; }
   [[nodiscard]] auto to_string() const -> std::string override;
-
-  ~If() final
-  {
-    delete condition;
-    delete consequence;
-    delete alternative;
-  }
 };
 
 class Function final : public Expression {
 public:
   std::vector<Identifier *> parameters;
   Block *body;
+  Scope scope;
   explicit Function(const Token &tkn,
                     const std::vector<Identifier *> &params = {})
       : Expression(tkn), parameters(params), body(nullptr) {}
@@ -263,40 +363,31 @@ public:
       : Expression(tkn), parameters(params), body(body){}
   [[nodiscard]] auto type() const -> Node override;
   [[nodiscard]] auto to_string() const -> std::string override;
-
-  ~Function() final
-  {
-    delete body;
-    for (auto *param : parameters) {
-      delete param;
-    }
-  }
 };
 
 class Call final : public Expression {
 public:
   Expression *function;
   std::vector<Expression *> arguments;
+  // set by the Optimizer when the callee is a small procedimiento: its body
+  // with the arguments in place of the parameters, which stands in for the
+  // call whenever the callee turns out to be a procedimiento with that body
+  Expression *inlined = nullptr;
+  const Block *inlined_body = nullptr;
   Call(const Token &tkn, Expression *func) : Expression(tkn), function(func) {}
   Call(const Token &tkn, Expression *func,
        const std::vector<Expression *> &args)
       : Expression(tkn), function(func), arguments(args) {}
   [[nodiscard]] auto type() const -> Node override;
   [[nodiscard]] auto to_string() const -> std::string override;
-
-  ~Call() final
-  {
-    delete function;
-    for (auto *arg : arguments) {
-      delete arg;
-    }
-  }
 };
 
 class StringLiteral : public Expression {
 public:
   const std::string value;
-  StringLiteral(const Token &tkn, const std::string &val)
+  // the heap's shared String for value, once the literal has been evaluated
+  obj::String *interned = nullptr;
+  StringLiteral(const Token &tkn, std::string_view val)
       : Expression(tkn), value(val) {}
   [[nodiscard]] auto type() const -> Node override;
   [[nodiscard]] auto to_string() const -> std::string override;
@@ -317,11 +408,6 @@ public:
       : Statement(tkn), name(ident), value(exp) {}
   [[nodiscard]] auto type() const -> Node override;
   [[nodiscard]] auto to_string() const -> std::string override;
-  ~AssignStatement()
-  {
-    delete name;
-    delete value;
-  }
 };
 
 class Programs_Guard {
@@ -329,8 +415,13 @@ class Programs_Guard {
 
 public:
   Programs_Guard() = default;
+  Programs_Guard(const Programs_Guard &) = delete;
+  auto operator=(const Programs_Guard &) -> Programs_Guard & = delete;
+  Programs_Guard(Programs_Guard &&) = delete;
+  auto operator=(Programs_Guard &&) -> Programs_Guard & = delete;
   void push_back(Program *prog);
-  auto new_program(const std::vector<Statement *> &statements) -> Program *;
+  auto new_program(const std::vector<Statement *> &statements,
+                   std::unique_ptr<Arena> nodes) -> Program *;
 
   ~Programs_Guard()
   {
@@ -1,109 +1,122 @@
 #ifndef BUILTIN_H
 #define BUILTIN_H
-#include "cleaner.h"
 #include "fmt/format.h"
+#include "gc.h"
 #include "object.h"
+#include "symbol.h"
 #include "utils.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
 #include <cstdlib>
-#include <map>
 #include <sstream>
 #include <string>
 #include <string_view>
+#include <utility>
 #include <vector>
 
-static constexpr std::string_view UNSUPPORTED_ARGUMENT_TYPE =
+inline constexpr std::string_view UNSUPPORTED_ARGUMENT_TYPE =
     "Argumento para longitud sin soporte, se recibió {} cerca de la línea {}";
-static constexpr std::string_view WRONG_ARGS_BUILTIN_FN =
+inline constexpr std::string_view WRONG_ARGS_BUILTIN_FN =
     "Número incorrecto de argumentos para {}, se recibieron {}, se esperaba 1, "
     "cerca de la línea {}";
 
-static const obj::BuiltinFunction longitud =
-    [](const std::vector<obj::Object *> &args,
-       const int line) -> obj::Object * {
+inline const obj::BuiltinFunction longitud =
+    [](const std::vector<obj::Value> &args, const int line) -> obj::Value {
   if (args.size() != 1) {
-    auto *error = new obj::Error{
-        fmt::format(WRONG_ARGS_BUILTIN_FN, "longitud", args.size(), line)};
-    eval_errors.push_back(error);
-    return error;
+    auto *error = heap.make<obj::Error>(
+        fmt::format(WRONG_ARGS_BUILTIN_FN, "longitud", args.size(), line));
+    return obj::Value::make_object(error);
   }
 
-  auto *argument = dynamic_cast<obj::String *>(args.at(0));
+  auto *argument = args.at(0).type() == obj::ObjectType::STRING
+                       ? static_cast<obj::String *>(args.at(0).as_object())
+                       : nullptr;
 
   if (argument != nullptr) {
-    if (argument->value.empty()) {
-      auto *integer = new obj::Integer(0);
-      cleaner.push_back(integer);
-      return integer;
-    }
-    auto *integer = new obj::Integer(argument->value.size());
-    cleaner.push_back(integer);
-    return integer;
+    return obj::Value::make_integer(
+        static_cast<std::int64_t>(argument->value().size()));
   }
 
-  auto *error = new obj::Error{
-      fmt::format(UNSUPPORTED_ARGUMENT_TYPE, args.at(0)->type_string(), line)};
-  eval_errors.push_back(error);
-  return error;
+  auto *error = heap.make<obj::Error>(
+      fmt::format(UNSUPPORTED_ARGUMENT_TYPE, args.at(0).type_string(), line));
+  return obj::Value::make_object(error);
 };
 
-static const obj::BuiltinFunction salir =
-    [](const std::vector<obj::Object *> & /*unused*/,
-       const int /*unused*/) -> obj::Object * { exit(EXIT_SUCCESS); };
+inline const obj::BuiltinFunction salir =
+    [](const std::vector<obj::Value> & /*unused*/,
+       const int /*unused*/) -> obj::Value { exit(EXIT_SUCCESS); };
 
-static const obj::BuiltinFunction entero_a_cadena =
-    [](const std::vector<obj::Object *> &args,
-       const int line) -> obj::Object * {
+inline const obj::BuiltinFunction entero_a_cadena =
+    [](const std::vector<obj::Value> &args, const int line) -> obj::Value {
   if (args.size() != 1) {
-    auto *error = new obj::Error{fmt::format(
-        WRONG_ARGS_BUILTIN_FN, "entero_a_cadena", args.size(), line)};
-    eval_errors.push_back(error);
-    return error;
+    auto *error = heap.make<obj::Error>(fmt::format(
+        WRONG_ARGS_BUILTIN_FN, "entero_a_cadena", args.size(), line));
+    return obj::Value::make_object(error);
   }
 
-  auto *argument = dynamic_cast<obj::Integer *>(args.at(0));
-  if (argument != nullptr) {
-    auto *str = new obj::String(std::to_string(argument->value));
-    cleaner.push_back(str);
-    return str;
+  if (args.at(0).is_integer()) {
+    auto *str =
+        heap.make<obj::String>(std::to_string(args.at(0).as_integer()));
+    return obj::Value::make_object(str);
   }
 
-  auto *error = new obj::Error{
-      fmt::format(UNSUPPORTED_ARGUMENT_TYPE, args.at(0)->type_string(), line)};
-  eval_errors.push_back(error);
-  return error;
+  auto *error = heap.make<obj::Error>(
+      fmt::format(UNSUPPORTED_ARGUMENT_TYPE, args.at(0).type_string(), line));
+  return obj::Value::make_object(error);
 };
 
-static const obj::BuiltinFunction cadena_a_entero =
-    [](const std::vector<obj::Object *> &args,
-       const int line) -> obj::Object * {
+inline const obj::BuiltinFunction cadena_a_entero =
+    [](const std::vector<obj::Value> &args, const int line) -> obj::Value {
   if (args.size() != 1) {
-    auto *error = new obj::Error{fmt::format(
-        WRONG_ARGS_BUILTIN_FN, "cadena_a_entero", args.size(), line)};
-    eval_errors.push_back(error);
-    return error;
+    auto *error = heap.make<obj::Error>(fmt::format(
+        WRONG_ARGS_BUILTIN_FN, "cadena_a_entero", args.size(), line));
+    return obj::Value::make_object(error);
   }
 
-  auto *argument = dynamic_cast<obj::String *>(args.at(0));
+  auto *argument = args.at(0).type() == obj::ObjectType::STRING
+                       ? static_cast<obj::String *>(args.at(0).as_object())
+                       : nullptr;
   if (argument != nullptr) {
-    std::stringstream stream(argument->value);
-    size_t val;
+    std::stringstream stream{std::string(argument->value())};
+    std::int64_t val = 0;
     stream >> val;
-    auto *integer = new obj::Integer(val);
-    cleaner.push_back(integer);
-    return integer;
+    return obj::Value::make_integer(val);
   }
 
-  auto *error = new obj::Error{
-      fmt::format(UNSUPPORTED_ARGUMENT_TYPE, args.at(0)->type_string(), line)};
-  eval_errors.push_back(error);
-  return error;
+  auto *error = heap.make<obj::Error>(
+      fmt::format(UNSUPPORTED_ARGUMENT_TYPE, args.at(0).type_string(), line));
+  return obj::Value::make_object(error);
 };
 
-static std::map<std::string_view, obj::Builtin> BUILTINS{
-    {"longitud", obj::Builtin(longitud)},
-    {"salir", obj::Builtin(salir)},
-    {"entero_a_cadena", obj::Builtin(entero_a_cadena)},
-    {"cadena_a_entero", obj::Builtin(cadena_a_entero)},
+inline std::array<obj::Builtin, 4> BUILTINS{
+    obj::Builtin(longitud),
+    obj::Builtin(salir),
+    obj::Builtin(entero_a_cadena),
+    obj::Builtin(cadena_a_entero),
 };
 
+// in the same order as BUILTINS
+inline constexpr std::array<std::string_view, 4> builtin_names{
+    "longitud", "salir", "entero_a_cadena", "cadena_a_entero"};
+
+// nullptr when there's no builtin with that name
+inline auto find_builtin(Symbol name) -> obj::Builtin *
+{
+  static const auto SYMBOLS = [] {
+    std::array<Symbol, builtin_names.size()> symbols{};
+    for (std::size_t i = 0; i < builtin_names.size(); i++) {
+      symbols.at(i) = intern_symbol(builtin_names.at(i));
+    }
+    return symbols;
+  }();
+
+  for (std::size_t i = 0; i < SYMBOLS.size(); i++) {
+    if (SYMBOLS.at(i) == name) {
+      return &BUILTINS.at(i);
+    }
+  }
+  return nullptr;
+}
+
 #endif // BUILTIN_H
@@ -0,0 +1,99 @@
+#include "code.h"
+#include "fmt/format.h"
+#include "object.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+void Chunk::write(std::uint8_t byte, int line)
+{
+  code.push_back(byte);
+  lines.push_back(line);
+}
+
+void Chunk::write(OpCode opcode, int line)
+{
+  write(static_cast<std::uint8_t>(opcode), line);
+}
+
+void Chunk::write_u16(std::size_t value, int line)
+{
+  write(static_cast<std::uint8_t>(value & 0xFFU), line);
+  write(static_cast<std::uint8_t>((value >> 8U) & 0xFFU), line);
+}
+
+void Chunk::write_u32(std::size_t value, int line)
+{
+  write_u16(value & 0xFFFFU, line);
+  write_u16((value >> 16U) & 0xFFFFU, line);
+}
+
+void Chunk::patch_u32(std::size_t offset, std::size_t value)
+{
+  for (std::size_t i = 0; i < 4; i++) {
+    code.at(offset + i) = static_cast<std::uint8_t>((value >> (8U * i)) & 0xFFU);
+  }
+}
+
+auto Chunk::read_u16(std::size_t offset) const -> std::size_t
+{
+  return static_cast<std::size_t>(code[offset]) |
+         (static_cast<std::size_t>(code[offset + 1]) << 8U);
+}
+
+auto Chunk::read_u32(std::size_t offset) const -> std::size_t
+{
+  return read_u16(offset) | (read_u16(offset + 2) << 16U);
+}
+
+auto Chunk::disassemble() const -> std::string
+{
+  std::string out;
+  std::size_t offset = 0;
+  while (offset < code.size()) {
+    auto opcode = static_cast<OpCode>(code.at(offset));
+    out.append(fmt::format("{:04} {}", offset,
+                           getNameForValue(opcodes_enums_strings, opcode)));
+    offset++;
+
+    switch (opcode) {
+    case OpCode::CONSTANT:
+      out.append(
+          fmt::format(" {}", constants.at(read_u16(offset)).inspect()));
+      offset += 2;
+      break;
+    case OpCode::GET_SLOT:
+      out.append(fmt::format(" {} {} {}", read_u16(offset),
+                             read_u16(offset + 2),
+                             symbol_name(names.at(read_u16(offset + 4)))));
+      offset += 6;
+      break;
+    case OpCode::SET_SLOT:
+      out.append(fmt::format(" {}", read_u16(offset)));
+      offset += 2;
+      break;
+    case OpCode::CLOSURE:
+      out.append(fmt::format(" {}", read_u16(offset)));
+      offset += 2;
+      break;
+    case OpCode::JUMP:
+    case OpCode::JUMP_IF_FALSE:
+      out.append(fmt::format(" {}", read_u32(offset)));
+      offset += 4;
+      break;
+    case OpCode::LOOP_BACK:
+      out.append(fmt::format(" {} {}", read_u32(offset), read_u16(offset + 4)));
+      offset += 6;
+      break;
+    case OpCode::CALL:
+    case OpCode::TAIL_CALL:
+      out.append(fmt::format(" {}", code.at(offset)));
+      offset++;
+      break;
+    default:
+      break;
+    }
+    out.append("\n");
+  }
+  return out;
+}
@@ -0,0 +1,112 @@
+#ifndef CODE_H
+#define CODE_H
+#include "ast.h"
+#include "object.h"
+#include "symbol.h"
+#include "utils.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+enum class OpCode : std::uint8_t {
+  CONSTANT,      // u16 constant index
+  NULL_VALUE,    //
+  TRUE_VALUE,    //
+  FALSE_VALUE,   //
+  POP,           //
+  GET_SLOT,      // u16 depth, u16 slot, u16 fallback name index
+  SET_SLOT,      // u16 slot, leaves the value on the stack
+  ADD,           //
+  SUB,           //
+  MUL,           //
+  DIV,           //
+  EQ,            //
+  NOT_EQ,        //
+  LT,            //
+  GT,            //
+  MINUS,         //
+  BANG,          //
+  JUMP,          // u32 absolute target
+  JUMP_IF_FALSE, // u32 absolute target, pops the condition
+  LOOP_BACK,     // u32 absolute target, u16 loop index
+  LOOP_ENTER,    // the loop condition starts right after this opcode
+  LOOP_EXIT,     //
+  CHECK_ERROR,   //
+  CLOSURE,       // u16 function index
+  CALL,          // u8 argument count
+  TAIL_CALL,     // u8 argument count, replaces the current frame
+  RETURN         //
+};
+
+static constexpr std::array<NameValuePair<OpCode>, 27> opcodes_enums_strings{
+    {{OpCode::CONSTANT, "CONSTANT"},
+     {OpCode::NULL_VALUE, "NULL_VALUE"},
+     {OpCode::TRUE_VALUE, "TRUE_VALUE"},
+     {OpCode::FALSE_VALUE, "FALSE_VALUE"},
+     {OpCode::POP, "POP"},
+     {OpCode::GET_SLOT, "GET_SLOT"},
+     {OpCode::SET_SLOT, "SET_SLOT"},
+     {OpCode::ADD, "ADD"},
+     {OpCode::SUB, "SUB"},
+     {OpCode::MUL, "MUL"},
+     {OpCode::DIV, "DIV"},
+     {OpCode::EQ, "EQ"},
+     {OpCode::NOT_EQ, "NOT_EQ"},
+     {OpCode::LT, "LT"},
+     {OpCode::GT, "GT"},
+     {OpCode::MINUS, "MINUS"},
+     {OpCode::BANG, "BANG"},
+     {OpCode::JUMP, "JUMP"},
+     {OpCode::JUMP_IF_FALSE, "JUMP_IF_FALSE"},
+     {OpCode::LOOP_BACK, "LOOP_BACK"},
+     {OpCode::LOOP_ENTER, "LOOP_ENTER"},
+     {OpCode::LOOP_EXIT, "LOOP_EXIT"},
+     {OpCode::CHECK_ERROR, "CHECK_ERROR"},
+     {OpCode::CLOSURE, "CLOSURE"},
+     {OpCode::CALL, "CALL"},
+     {OpCode::TAIL_CALL, "TAIL_CALL"},
+     {OpCode::RETURN, "RETURN"}}};
+
+class FunctionProto;
+
+class Chunk {
+public:
+  std::vector<std::uint8_t> code;
+  std::vector<int> lines;
+  std::vector<obj::Value> constants;
+  std::vector<Symbol> names;
+  std::vector<const FunctionProto *> functions;
+  std::vector<ast::LoopStatement *> loops;
+
+  void write(std::uint8_t byte, int line);
+  void write(OpCode opcode, int line);
+  void write_u16(std::size_t value, int line);
+  void write_u32(std::size_t value, int line);
+  void patch_u32(std::size_t offset, std::size_t value);
+  [[nodiscard]] auto read_u16(std::size_t offset) const -> std::size_t;
+  [[nodiscard]] auto read_u32(std::size_t offset) const -> std::size_t;
+  [[nodiscard]] auto disassemble() const -> std::string;
+};
+
+class FunctionProto {
+public:
+  std::vector<ast::Identifier *> parameters;
+  ast::Block *body;
+  const ast::Scope *scope;
+  Chunk chunk;
+
+  FunctionProto(const std::vector<ast::Identifier *> &params, ast::Block *blk,
+                const ast::Scope *scp)
+      : parameters(params), body(blk), scope(scp) {}
+};
+
+class Bytecode {
+public:
+  Chunk main;
+  std::vector<std::unique_ptr<FunctionProto>> functions;
+};
+
+#endif // CODE_H
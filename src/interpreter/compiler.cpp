@@ -0,0 +1,369 @@
+#include "compiler.h"
+#include "ast.h"
+#include "code.h"
+#include "gc.h"
+#include "object.h"
+#include "utils.h"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <fmt/format.h>
+#include <limits>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+using namespace ast;
+
+inline constexpr std::size_t MAX_U16_OPERAND =
+    std::numeric_limits<std::uint16_t>::max();
+inline constexpr std::size_t MAX_CALL_ARGUMENTS =
+    std::numeric_limits<std::uint8_t>::max();
+
+// statements whose value can never be an error don't need a CHECK_ERROR
+auto can_produce_error(Statement *statement) -> bool
+{
+  if (statement->type() == Node::Loop) {
+    return false;
+  }
+  if (statement->type() != Node::ExpressionStatement) {
+    return true;
+  }
+
+  switch (static_cast<ExpressionStatement *>(statement)->expression->type()) {
+  case Node::Integer:
+  case Node::Boolean:
+  case Node::StringLiteral:
+  case Node::Null:
+  case Node::Function:
+    return false;
+  default:
+    return true;
+  }
+}
+
+auto Compiler::compile_program(Program *program) -> std::unique_ptr<Bytecode>
+{
+  auto result = std::make_unique<Bytecode>();
+  bytecode = result.get();
+  chunk = &result->main;
+
+  compile_block(program->statements, 1);
+  chunk->write(OpCode::RETURN, chunk->lines.empty() ? 1 : chunk->lines.back());
+
+  bytecode = nullptr;
+  chunk = nullptr;
+  return result;
+}
+
+auto Compiler::compile_function(Bytecode &target,
+                                const std::vector<Identifier *> &parameters,
+                                Block *body, const Scope *scope)
+    -> FunctionProto *
+{
+  bytecode = &target;
+  auto *proto = compile_function(parameters, body, scope);
+  bytecode = nullptr;
+  return proto;
+}
+
+auto Compiler::compile_function(const std::vector<Identifier *> &parameters,
+                                Block *body, const Scope *scope)
+    -> FunctionProto *
+{
+  auto *enclosing = chunk;
+  bytecode->functions.push_back(
+      std::make_unique<FunctionProto>(parameters, body, scope));
+  auto *proto = bytecode->functions.back().get();
+
+  chunk = &proto->chunk;
+  compile_block(body->statements, body->token.line);
+  chunk->write(OpCode::RETURN, chunk->lines.empty() ? body->token.line
+                                                    : chunk->lines.back());
+  chunk = enclosing;
+
+  return proto;
+}
+
+void Compiler::compile_block(const std::vector<Statement *> &statements,
+                             int line)
+{
+  if (statements.empty()) {
+    chunk->write(OpCode::NULL_VALUE, line);
+    return;
+  }
+
+  for (std::size_t i = 0; i < statements.size(); i++) {
+    auto *statement = statements.at(i);
+    compile(statement);
+    if (can_produce_error(statement)) {
+      chunk->write(OpCode::CHECK_ERROR, chunk->lines.back());
+    }
+    if (i + 1 < statements.size()) {
+      chunk->write(OpCode::POP, chunk->lines.back());
+    }
+  }
+}
+
+void Compiler::compile(ASTNode *node)
+{
+  switch (node->type()) {
+
+  case Node::Program: {
+    auto *cast_program = static_cast<Program *>(node);
+    compile_block(cast_program->statements, 1);
+    break;
+  }
+
+  case Node::ExpressionStatement: {
+    compile(static_cast<ExpressionStatement *>(node)->expression);
+    break;
+  }
+
+  case Node::Integer: {
+    auto *cast_int = static_cast<Integer *>(node);
+    auto integer =
+        obj::Value::make_integer(static_cast<std::int64_t>(cast_int->value));
+    emit_u16_operand(OpCode::CONSTANT, add_constant(integer),
+                     cast_int->token.line);
+    break;
+  }
+
+  case Node::StringLiteral: {
+    auto *cast_str_lit = static_cast<StringLiteral *>(node);
+    auto *str = literal_string(cast_str_lit);
+    emit_u16_operand(OpCode::CONSTANT,
+                     add_constant(obj::Value::make_object(str)),
+                     cast_str_lit->token.line);
+    break;
+  }
+
+  case Node::Boolean: {
+    auto *cast_bool = static_cast<Boolean *>(node);
+    chunk->write(cast_bool->value ? OpCode::TRUE_VALUE : OpCode::FALSE_VALUE,
+                 cast_bool->token.line);
+    break;
+  }
+
+  case Node::Null:
+    chunk->write(OpCode::NULL_VALUE, static_cast<Null *>(node)->token.line);
+    break;
+
+  case Node::Prefix:
+    compile_prefix(static_cast<Prefix *>(node));
+    break;
+
+  case Node::Infix:
+    compile_infix(static_cast<Infix *>(node));
+    break;
+
+  case Node::Block: {
+    auto *cast_block = static_cast<Block *>(node);
+    compile_block(cast_block->statements, cast_block->token.line);
+    break;
+  }
+
+  case Node::If:
+    compile_if(static_cast<If *>(node));
+    break;
+
+  case Node::Loop:
+    compile_loop(static_cast<LoopStatement *>(node));
+    break;
+
+  case Node::ReturnStatement: {
+    auto *cast_rtn_st = static_cast<ReturnStatement *>(node);
+    if (cast_rtn_st->tail_call) {
+      // only reaches the RETURN when the callee isn't a procedimiento
+      compile_call(static_cast<Call *>(cast_rtn_st->return_value),
+                   OpCode::TAIL_CALL);
+    }
+    else {
+      compile(cast_rtn_st->return_value);
+    }
+    chunk->write(OpCode::RETURN, cast_rtn_st->token.line);
+    break;
+  }
+
+  case Node::LetStatement: {
+    auto *cast_let_st = static_cast<LetStatement *>(node);
+    compile(cast_let_st->value);
+    chunk->write(OpCode::SET_SLOT, cast_let_st->token.line);
+    emit_variable_operand(cast_let_st->name->slot, cast_let_st->token.line);
+    break;
+  }
+
+  case Node::AssignStatement: {
+    auto *cast_assign = static_cast<AssignStatement *>(node);
+    compile(cast_assign->value);
+    chunk->write(OpCode::SET_SLOT, cast_assign->token.line);
+    emit_variable_operand(cast_assign->name->slot, cast_assign->token.line);
+    break;
+  }
+
+  case Node::Identifier: {
+    auto *cast_ident = static_cast<Identifier *>(node);
+    const auto line = cast_ident->token.line;
+    chunk->write(OpCode::GET_SLOT, line);
+    emit_variable_operand(cast_ident->depth, line);
+    emit_variable_operand(cast_ident->slot, line);
+    chunk->write_u16(name_index(cast_ident->symbol), line);
+    break;
+  }
+
+  case Node::Function: {
+    auto *cast_func = static_cast<Function *>(node);
+    auto *proto = compile_function(cast_func->parameters, cast_func->body,
+                                   &cast_func->scope);
+    chunk->functions.push_back(proto);
+    emit_u16_operand(OpCode::CLOSURE, chunk->functions.size() - 1,
+                     cast_func->token.line);
+    break;
+  }
+
+  case Node::Call:
+    compile_call(static_cast<Call *>(node));
+    break;
+
+  default:
+    chunk->write(OpCode::NULL_VALUE,
+                 chunk->lines.empty() ? 1 : chunk->lines.back());
+    break;
+  }
+}
+
+void Compiler::compile_loop(LoopStatement *loop)
+{
+  const auto line = loop->token.line;
+  chunk->write(OpCode::LOOP_ENTER, line);
+  const auto condition_start = chunk->code.size();
+
+  compile(loop->condition);
+  const auto exit_jump = emit_jump(OpCode::JUMP_IF_FALSE, line);
+
+  compile(loop->repeat);
+  chunk->write(OpCode::POP, line);
+  chunk->loops.push_back(loop);
+  if (chunk->loops.size() - 1 > MAX_U16_OPERAND) {
+    errors_list.push_back(fmt::format(TOO_MANY_LOOPS, line));
+  }
+  chunk->write(OpCode::LOOP_BACK, line);
+  chunk->write_u32(condition_start, line);
+  chunk->write_u16(chunk->loops.size() - 1, line);
+
+  patch_jump(exit_jump);
+  chunk->write(OpCode::LOOP_EXIT, line);
+  chunk->write(OpCode::NULL_VALUE, line);
+}
+
+void Compiler::compile_if(If *if_expression)
+{
+  const auto line = if_expression->token.line;
+  compile(if_expression->condition);
+  const auto else_jump = emit_jump(OpCode::JUMP_IF_FALSE, line);
+
+  compile(if_expression->consequence);
+  const auto end_jump = emit_jump(OpCode::JUMP, line);
+
+  patch_jump(else_jump);
+  if (if_expression->alternative != nullptr) {
+    compile(if_expression->alternative);
+  }
+  else {
+    chunk->write(OpCode::NULL_VALUE, line);
+  }
+  patch_jump(end_jump);
+}
+
+void Compiler::compile_infix(Infix *infix)
+{
+  compile(infix->left);
+  compile(infix->right);
+
+  static constexpr std::array<std::pair<Operator, OpCode>, 8> infix_opcodes{
+      {{Operator::PLUS, OpCode::ADD},
+       {Operator::MINUS, OpCode::SUB},
+       {Operator::MULTIPLICATION, OpCode::MUL},
+       {Operator::DIVISION, OpCode::DIV},
+       {Operator::EQ, OpCode::EQ},
+       {Operator::NOT_EQ, OpCode::NOT_EQ},
+       {Operator::LT, OpCode::LT},
+       {Operator::GT, OpCode::GT}}};
+  static constexpr auto OPCODES =
+      Map<Operator, OpCode, infix_opcodes.size()>{{infix_opcodes}};
+
+  chunk->write(OPCODES.at(infix->op), infix->token.line);
+}
+
+void Compiler::compile_prefix(Prefix *prefix)
+{
+  compile(prefix->right);
+  chunk->write(prefix->op == Operator::MINUS ? OpCode::MINUS : OpCode::BANG,
+               prefix->token.line);
+}
+
+void Compiler::compile_call(Call *call, OpCode opcode)
+{
+  const auto line = call->token.line;
+  compile(call->function);
+  for (auto *arg : call->arguments) {
+    compile(arg);
+  }
+
+  if (call->arguments.size() > MAX_CALL_ARGUMENTS) {
+    errors_list.push_back(fmt::format(TOO_MANY_ARGUMENTS, line));
+  }
+  chunk->write(opcode, line);
+  chunk->write(static_cast<std::uint8_t>(call->arguments.size()), line);
+}
+
+void Compiler::emit_u16_operand(OpCode opcode, std::size_t operand, int line)
+{
+  if (operand > MAX_U16_OPERAND) {
+    errors_list.push_back(fmt::format(TOO_MANY_CONSTANTS, line));
+  }
+  chunk->write(opcode, line);
+  chunk->write_u16(operand, line);
+}
+
+void Compiler::emit_variable_operand(std::size_t operand, int line)
+{
+  if (operand > MAX_U16_OPERAND) {
+    errors_list.push_back(fmt::format(TOO_MANY_VARIABLES, line));
+  }
+  chunk->write_u16(operand, line);
+}
+
+auto Compiler::emit_jump(OpCode opcode, int line) -> std::size_t
+{
+  chunk->write(opcode, line);
+  const auto operand_offset = chunk->code.size();
+  chunk->write_u32(0, line);
+  return operand_offset;
+}
+
+void Compiler::patch_jump(std::size_t operand_offset)
+{
+  chunk->patch_u32(operand_offset, chunk->code.size());
+}
+
+auto Compiler::add_constant(obj::Value constant) -> std::size_t
+{
+  chunk->constants.push_back(constant);
+  return chunk->constants.size() - 1;
+}
+
+auto Compiler::name_index(Symbol name) -> std::size_t
+{
+  auto itr = std::find(chunk->names.begin(), chunk->names.end(), name);
+  if (itr != chunk->names.end()) {
+    return static_cast<std::size_t>(itr - chunk->names.begin());
+  }
+  chunk->names.push_back(name);
+  return chunk->names.size() - 1;
+}
+
+auto Compiler::errors() -> std::vector<std::string> & { return errors_list; }
@@ -0,0 +1,56 @@
+#ifndef COMPILER_H
+#define COMPILER_H
+#include "ast.h"
+#include "code.h"
+#include "symbol.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+inline constexpr std::string_view TOO_MANY_CONSTANTS =
+    "Demasiadas constantes en un solo bloque cerca de la línea {}";
+inline constexpr std::string_view TOO_MANY_ARGUMENTS =
+    "Demasiados argumentos en la llamada cerca de la línea {}";
+inline constexpr std::string_view TOO_MANY_LOOPS =
+    "Demasiados ciclos en un solo bloque cerca de la línea {}";
+inline constexpr std::string_view TOO_MANY_VARIABLES =
+    "Demasiadas variables en un solo ámbito cerca de la línea {}";
+
+class Compiler {
+private:
+  Bytecode *bytecode = nullptr;
+  Chunk *chunk = nullptr;
+  std::vector<std::string> errors_list;
+
+  void compile(ast::ASTNode *node);
+  void compile_block(const std::vector<ast::Statement *> &statements,
+                     int line);
+  void compile_loop(ast::LoopStatement *loop);
+  void compile_if(ast::If *if_expression);
+  void compile_infix(ast::Infix *infix);
+  void compile_prefix(ast::Prefix *prefix);
+  void compile_call(ast::Call *call, OpCode opcode = OpCode::CALL);
+  auto compile_function(const std::vector<ast::Identifier *> &parameters,
+                        ast::Block *body, const ast::Scope *scope)
+      -> FunctionProto *;
+  void emit_variable_operand(std::size_t operand, int line);
+  void emit_u16_operand(OpCode opcode, std::size_t operand, int line);
+  auto emit_jump(OpCode opcode, int line) -> std::size_t;
+  void patch_jump(std::size_t operand_offset);
+  auto add_constant(obj::Value constant) -> std::size_t;
+  auto name_index(Symbol name) -> std::size_t;
+
+public:
+  Compiler() = default;
+  auto compile_program(ast::Program *program) -> std::unique_ptr<Bytecode>;
+  auto compile_function(Bytecode &target,
+                        const std::vector<ast::Identifier *> &parameters,
+                        ast::Block *body, const ast::Scope *scope)
+      -> FunctionProto *;
+  auto errors() -> std::vector<std::string> &;
+};
+
+#endif // COMPILER_H
@@ -1,276 +1,481 @@
 #include "evaluator.h"
 #include "ast.h"
+#include "gc.h"
+#include "jit.h"
 #include "object.h"
+#include "optimizer.h"
+#include "resolver.h"
+#include <algorithm>
+#include <utility>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <pthread.h>
+#include <sys/resource.h>
+#define MIMIR_HAS_PTHREAD
+#endif
 
 using namespace ast;
 
-auto to_boolean_object(const std::string &operatr, obj::Object *left,
-                       obj::Object *right) -> obj::Object *
-{
-  switch (left->type()) {
-  case obj::ObjectType::BOOLEAN: {
-    if (right->type() == obj::ObjectType::BOOLEAN && operatr == "==") {
-      auto value = static_cast<obj::Boolean *>(left)->value ==
-                   static_cast<obj::Boolean *>(right)->value;
-      return value ? TRUE.get() : FALSE.get();
-    }
-    if (right->type() == obj::ObjectType::BOOLEAN && operatr == "!=") {
-      auto value = static_cast<obj::Boolean *>(left)->value !=
-                   static_cast<obj::Boolean *>(right)->value;
-      return value ? TRUE.get() : FALSE.get();
-    }
-    if (operatr == "!=") {
-      return TRUE.get();
-    }
+static std::size_t max_call_depth = NO_CALL_DEPTH_LIMIT; // NOLINT
+static std::size_t call_depth = 0;                       // NOLINT
+static StackBudget stack_budget;                         // NOLINT
+static ReturnSignal returning;                           // NOLINT
 
-    return FALSE.get();
-  }
+void set_max_call_depth(std::size_t depth)
+{
+  max_call_depth = depth;
+}
 
-  case obj::ObjectType::STRING: {
-    if (operatr == "!=") {
-      return TRUE.get();
-    }
+auto get_max_call_depth() -> std::size_t
+{
+  return max_call_depth;
+}
 
-    return FALSE.get();
-  }
+// the stack grows down on every platform the interpreter runs on
+static auto stack_address() -> std::uintptr_t
+{
+  return reinterpret_cast<std::uintptr_t>(__builtin_frame_address(0));
+}
 
-  case obj::ObjectType::_NULL: {
-    if (right->type() == obj::ObjectType::_NULL && operatr == "==") {
-      return TRUE.get();
+// the lowest address the stack of this thread can grow to, found once per
+// thread since reading it can mean parsing /proc/self/maps
+static auto stack_bottom() -> std::uintptr_t
+{
+  static thread_local const std::uintptr_t bottom = []() -> std::uintptr_t {
+#if defined(MIMIR_HAS_PTHREAD) && defined(__linux__)
+    pthread_attr_t attr;
+    if (pthread_getattr_np(pthread_self(), &attr) == 0) {
+      void *low = nullptr;
+      std::size_t size = 0;
+      const auto found = pthread_attr_getstack(&attr, &low, &size) == 0;
+      pthread_attr_destroy(&attr);
+      if (found) {
+        return reinterpret_cast<std::uintptr_t>(low);
+      }
     }
-    if (operatr == "!=" && right->type() != obj::ObjectType::_NULL) {
-      return TRUE.get();
+#endif
+    auto size = DEFAULT_NATIVE_STACK;
+#ifdef MIMIR_HAS_PTHREAD
+    rlimit limit{};
+    if (getrlimit(RLIMIT_STACK, &limit) == 0 &&
+        limit.rlim_cur != RLIM_INFINITY) {
+      size = static_cast<std::size_t>(limit.rlim_cur);
     }
+#endif
+    // a guess measured from here, the stack used so far being unknown
+    const auto here = stack_address();
+    return here > size ? here - size : 0;
+  }();
+  return bottom;
+}
 
-    return FALSE.get();
-  }
-
-  case obj::ObjectType::INTEGER: {
-    if (operatr == "!=") {
-      return TRUE.get();
-    }
+void StackBudget::start()
+{
+  base = stack_address();
+  const auto below = base > stack_bottom() ? base - stack_bottom() : 0;
+  room = below - std::min(below / 4, NATIVE_STACK_RESERVE);
+}
 
-    return FALSE.get();
+auto StackBudget::calls_left(std::size_t depth) const -> std::size_t
+{
+  const auto here = stack_address();
+  if (depth == 0 || here >= base) {
+    return NO_CALL_DEPTH_LIMIT;
   }
-
-  default:
-    return FALSE.get();
+  const auto used = base - here;
+  if (used >= room) {
+    return 0;
   }
+  return (room - used) / std::max<std::size_t>(used / depth, 1);
 }
 
-auto to_boolean_object(bool value) -> obj::Object *
+auto StackBudget::bytes_left() const -> std::size_t
 {
-  return value ? TRUE.get() : FALSE.get();
+  const auto here = stack_address();
+  const auto used = here < base ? base - here : 0;
+  return used < room ? room - used : 0;
 }
 
-inline auto is_truthy(const obj::Object *const obj) -> bool
+void run_with_stack(std::size_t stack_size, const std::function<void()> &work)
 {
-  if (obj == _NULL.get()) {
-    return false;
-  }
-  if (obj == TRUE.get()) {
-    return true;
-  }
-  if (obj == FALSE.get()) {
-    return false;
+#ifdef MIMIR_HAS_PTHREAD
+  pthread_attr_t attr;
+  if (pthread_attr_init(&attr) == 0) {
+    pthread_t thread;
+    auto body = work;
+    const auto started =
+        pthread_attr_setstacksize(&attr, stack_size) == 0 &&
+        pthread_create(
+            &thread, &attr,
+            [](void *arg) -> void * {
+              (*static_cast<std::function<void()> *>(arg))();
+              return nullptr;
+            },
+            &body) == 0;
+    pthread_attr_destroy(&attr);
+    if (started) {
+      pthread_join(thread, nullptr);
+      return;
+    }
   }
-  return true;
+#endif
+  work();
+}
+
+class CallDepthGuard {
+public:
+  CallDepthGuard() { call_depth++; }
+  CallDepthGuard(const CallDepthGuard &) = delete;
+  auto operator=(const CallDepthGuard &) -> CallDepthGuard & = delete;
+  CallDepthGuard(CallDepthGuard &&) = delete;
+  auto operator=(CallDepthGuard &&) -> CallDepthGuard & = delete;
+  ~CallDepthGuard() { call_depth--; }
+};
+
+auto to_boolean_object(bool value) -> obj::Value
+{
+  return value ? TRUE : FALSE;
 }
 
 auto evaluate_expression(const std::vector<Expression *> &expressions,
-                         obj::Environment *env) -> std::vector<obj::Object *>
+                         obj::Environment *env) -> std::vector<obj::Value>
 {
-  auto result = std::vector<obj::Object *>();
+  auto result = std::vector<obj::Value>();
+  result.reserve(expressions.size());
 
   for (auto *exp : expressions) {
-    auto *evaluated = evaluate(exp, env);
-
-    if (evaluated != nullptr) {
-      result.push_back(evaluated);
+    result.push_back(evaluate(exp, env));
+    // released by the RootScope of the call being evaluated
+    heap.push_root(result.back());
+    if (returning.active()) {
+      break;
     }
   }
 
   return result;
 }
 
-auto evaluate_string_infix_expression(const std::string &operatr,
-                                      obj::Object *left, obj::Object *right,
-                                      const int line) -> obj::Object *
+auto evaluate_identifier(Symbol name, obj::Environment *env)
+    -> obj::Value
 {
-  auto left_value = static_cast<obj::String *>(left)->value;
-  auto right_value = static_cast<obj::String *>(right)->value;
-
-  if (operatr == "+") {
-    auto *str = new obj::String(left_value + right_value);
-    cleaner.push_back(str);
-    return str;
-  }
-  if (operatr == "==") {
-    return to_boolean_object(left_value == right_value);
+  if (env != nullptr) {
+    auto value = env->lookup(name);
+    if (!value.is_unset()) {
+      return value;
+    }
   }
-  if (operatr == "!=") {
-    return to_boolean_object(left_value != right_value);
+  if (auto *builtin = find_builtin(name)) {
+    return obj::Value::make_object(builtin);
   }
-
-  auto *error =
-      new obj::Error{fmt::format(UNKNOWN_INFIX_OPERATION, left->type_string(),
-                                 operatr, right->type_string(), line)};
-  eval_errors.push_back(error);
-
-  return error;
+  return _NULL;
 }
 
-auto evaluate_identifier(Identifier *ident, obj::Environment *env)
-    -> obj::Object *
+auto evaluate_identifier(Identifier *identifier, obj::Environment *env)
+    -> obj::Value
 {
-  if (env->item_exist(ident->value)) {
-    return env->get_item(ident->value);
+  auto *scope_env = env->ancestor(identifier->depth);
+  auto value = scope_env->get_slot(identifier->slot);
+  if (!value.is_unset()) {
+    return value;
+  }
+  // not assigned yet in its own scope, so an outer one or a builtin may have it
+  auto *outer = scope_env->enclosing();
+  if (outer != nullptr) {
+    return evaluate_identifier(identifier->symbol, outer);
+  }
+  // an unset global can only be a builtin, and which one never changes
+  if (!identifier->builtin_cached) {
+    identifier->builtin = find_builtin(identifier->symbol);
+    identifier->builtin_cached = true;
   }
-  if (BUILTINS.find(ident->value) != BUILTINS.end()) {
-    return &BUILTINS.at(ident->value);
+  if (identifier->builtin != nullptr) {
+    return obj::Value::make_object(identifier->builtin);
   }
-  return _NULL.get();
+  return _NULL;
 }
 
-inline auto evaluate_integer_infix_expression(const std::string &operatr,
-                                              obj::Object *left,
-                                              obj::Object *right,
-                                              const int line) -> obj::Object *
+auto operator_string(Operator op) -> std::string_view
 {
-  auto left_value = static_cast<obj::Integer *>(left)->value;
-  auto right_value = static_cast<obj::Integer *>(right)->value;
+  return getNameForValue(operators_enums_strings, op);
+}
 
-  if (operatr == "+") {
-    auto *integer = new obj::Integer(left_value + right_value);
-    cleaner.push_back(integer);
-    return integer;
-  }
-  if (operatr == "-") {
-    auto *integer = new obj::Integer(left_value - right_value);
-    cleaner.push_back(integer);
-    return integer;
-  }
-  if (operatr == "*") {
-    auto *integer = new obj::Integer(left_value * right_value);
-    cleaner.push_back(integer);
-    return integer;
-  }
-  if (operatr == "/") {
-    auto *integer = new obj::Integer(left_value / right_value);
-    cleaner.push_back(integer);
-    return integer;
+auto unknown_infix_operation(Operator op, obj::Value left, obj::Value right,
+                             const int line) -> obj::Value
+{
+  auto *error = heap.make<obj::Error>(
+      fmt::format(UNKNOWN_INFIX_OPERATION, left.type_string(),
+                  operator_string(op), right.type_string(), line));
+  return obj::Value::make_object(error);
+}
+
+auto evaluate_integer_infix_expression(Operator op, obj::Value left,
+                                       obj::Value right, const int line)
+    -> obj::Value
+{
+  auto left_value = left.as_integer();
+  auto right_value = right.as_integer();
+
+  switch (op) {
+  case Operator::PLUS:
+    return obj::Value::make_integer(wrapping_add(left_value, right_value));
+  case Operator::MINUS:
+    return obj::Value::make_integer(wrapping_sub(left_value, right_value));
+  case Operator::MULTIPLICATION:
+    return obj::Value::make_integer(wrapping_mul(left_value, right_value));
+  case Operator::DIVISION: {
+    if (right_value == 0) {
+      auto *error = heap.make<obj::Error>(
+          fmt::format(DIVISION_BY_ZERO, left_value, line));
+      return obj::Value::make_object(error);
+    }
+    return obj::Value::make_integer(wrapping_div(left_value, right_value));
   }
-  if (operatr == "<") {
+  case Operator::LT:
     return to_boolean_object(left_value < right_value);
-  }
-  if (operatr == ">") {
+  case Operator::GT:
     return to_boolean_object(left_value > right_value);
-  }
-  if (operatr == "==") {
+  case Operator::EQ:
     return to_boolean_object(left_value == right_value);
-  }
-  if (operatr == "!=") {
+  case Operator::NOT_EQ:
     return to_boolean_object(left_value != right_value);
+  default:
+    return unknown_infix_operation(op, left, right, line);
   }
+}
 
-  auto *error =
-      new obj::Error{fmt::format(UNKNOWN_INFIX_OPERATION, left->type_string(),
-                                 operatr, right->type_string(), line)};
-  eval_errors.push_back(error);
+auto evaluate_string_infix_expression(Operator op, obj::Value left,
+                                      obj::Value right, const int line)
+    -> obj::Value
+{
+  const auto *left_string = static_cast<obj::String *>(left.as_object());
+  const auto left_value = left_string->value();
+  const auto right_value =
+      static_cast<obj::String *>(right.as_object())->value();
 
-  return error;
+  switch (op) {
+  case Operator::PLUS: {
+    auto *str = heap.make<obj::String>(*left_string, right_value);
+    return obj::Value::make_object(str);
+  }
+  case Operator::EQ:
+    return to_boolean_object(left_value == right_value);
+  case Operator::NOT_EQ:
+    return to_boolean_object(left_value != right_value);
+  default:
+    return unknown_infix_operation(op, left, right, line);
+  }
 }
 
-auto evaluate_infix_expression(const std::string &operatr, obj::Object *left,
-                               obj::Object *right, const int line)
-    -> obj::Object *
+auto evaluate_boolean_infix_expression(Operator op, obj::Value left,
+                                       obj::Value right, const int line)
+    -> obj::Value
 {
-  if (left->type() == obj::ObjectType::INTEGER &&
-      right->type() == obj::ObjectType::INTEGER) {
-    return evaluate_integer_infix_expression(operatr, left, right, line);
+  switch (op) {
+  case Operator::EQ:
+    return to_boolean_object(left.as_boolean() == right.as_boolean());
+  case Operator::NOT_EQ:
+    return to_boolean_object(left.as_boolean() != right.as_boolean());
+  default:
+    return unknown_infix_operation(op, left, right, line);
   }
-  if (left->type() == obj::ObjectType::STRING &&
-      right->type() == obj::ObjectType::STRING) {
-    return evaluate_string_infix_expression(operatr, left, right, line);
+}
+
+auto evaluate_null_infix_expression(Operator op, obj::Value left,
+                                    obj::Value right, const int line)
+    -> obj::Value
+{
+  switch (op) {
+  case Operator::EQ:
+    return TRUE;
+  case Operator::NOT_EQ:
+    return FALSE;
+  default:
+    return unknown_infix_operation(op, left, right, line);
   }
-  if (operatr == "==" || operatr == "!=") {
-    return to_boolean_object(operatr, left, right);
+}
+
+// operands of different types, and types without operators of their own
+auto evaluate_mixed_infix_expression(Operator op, obj::Value left,
+                                     obj::Value right, const int line)
+    -> obj::Value
+{
+  if (op == Operator::EQ || op == Operator::NOT_EQ) {
+    switch (left.type()) {
+    case obj::ObjectType::BOOLEAN:
+    case obj::ObjectType::STRING:
+    case obj::ObjectType::_NULL:
+    case obj::ObjectType::INTEGER:
+      return to_boolean_object(op == Operator::NOT_EQ);
+    default:
+      // functions are neither equal nor different to anything
+      return FALSE;
+    }
   }
-  if (left->type() != right->type()) {
-    auto *error =
-        new obj::Error{fmt::format(TYPE_MISMATCH, left->type_string(), operatr,
-                                   right->type_string(), line)};
-    eval_errors.push_back(error);
-    return error;
+  if (left.type() != right.type()) {
+    auto *error = heap.make<obj::Error>(
+        fmt::format(TYPE_MISMATCH, left.type_string(), operator_string(op),
+                    right.type_string(), line));
+    return obj::Value::make_object(error);
   }
 
-  auto *error =
-      new obj::Error{fmt::format(UNKNOWN_INFIX_OPERATION, left->type_string(),
-                                 operatr, right->type_string(), line)};
-  eval_errors.push_back(error);
-
-  return error;
+  return unknown_infix_operation(op, left, right, line);
 }
 
-inline auto evaluate_minus_operator_expression(obj::Object *right,
-                                               const int line) -> obj::Object *
+// an error reaching an operator, like a stack overflow deep inside a call,
+// is passed on rather than reported as a type mismatch about it
+auto pass_error_operand(Operator /*op*/, obj::Value left, obj::Value right,
+                        const int /*line*/) -> obj::Value
 {
-  if (right->type() != obj::ObjectType::INTEGER) {
-    auto *error = new obj::Error{
-        fmt::format(UNKNOWN_PREFIX_OPERATION, "-", right->type_string(), line)};
-    eval_errors.push_back(error);
-    return error;
-  }
+  return left.type() == obj::ObjectType::ERROR ? left : right;
+}
+
+using InfixHandler = auto (*)(Operator, obj::Value, obj::Value, int)
+    -> obj::Value;
 
-  auto *cast_right = static_cast<obj::Integer *>(right);
-  auto *integer = new obj::Integer(-cast_right->value);
-  cleaner.push_back(integer);
+inline constexpr std::size_t OBJECT_TYPES = obj::objects_enums_string.size();
 
-  return integer;
+constexpr auto type_index(obj::ObjectType type) -> std::size_t
+{
+  return static_cast<std::size_t>(type);
 }
 
-inline auto evaluate_bang_operator_expression(const obj::Object *const right)
-    -> obj::Object *
+// indexed by the types of the left and right operands
+static constexpr auto INFIX_HANDLERS = [] {
+  std::array<std::array<InfixHandler, OBJECT_TYPES>, OBJECT_TYPES> table{};
+  for (auto &row : table) {
+    row.fill(evaluate_mixed_infix_expression);
+  }
+  table[type_index(obj::ObjectType::INTEGER)]
+       [type_index(obj::ObjectType::INTEGER)] =
+           evaluate_integer_infix_expression;
+  table[type_index(obj::ObjectType::STRING)]
+       [type_index(obj::ObjectType::STRING)] = evaluate_string_infix_expression;
+  table[type_index(obj::ObjectType::BOOLEAN)]
+       [type_index(obj::ObjectType::BOOLEAN)] =
+           evaluate_boolean_infix_expression;
+  table[type_index(obj::ObjectType::_NULL)]
+       [type_index(obj::ObjectType::_NULL)] = evaluate_null_infix_expression;
+  for (std::size_t type = 0; type < OBJECT_TYPES; type++) {
+    table[type_index(obj::ObjectType::ERROR)][type] = pass_error_operand;
+    table[type][type_index(obj::ObjectType::ERROR)] = pass_error_operand;
+  }
+  return table;
+}();
+
+auto evaluate_infix_expression(Operator op, obj::Value left, obj::Value right,
+                               const int line) -> obj::Value
 {
-  if (right == TRUE.get()) {
-    return FALSE.get();
-  }
-  if (right == FALSE.get()) {
-    return TRUE.get();
+  if (left.is_integer() && right.is_integer()) {
+    return evaluate_integer_infix_expression(op, left, right, line);
   }
-  if (right == _NULL.get()) {
-    return TRUE.get();
+  return INFIX_HANDLERS[type_index(left.type())][type_index(right.type())](
+      op, left, right, line);
+}
+
+constexpr auto integer_state(Operator op) -> InfixState
+{
+  switch (op) {
+  case Operator::PLUS:
+    return InfixState::INTEGER_PLUS;
+  case Operator::MINUS:
+    return InfixState::INTEGER_MINUS;
+  case Operator::MULTIPLICATION:
+    return InfixState::INTEGER_MULTIPLICATION;
+  case Operator::DIVISION:
+    return InfixState::INTEGER_DIVISION;
+  case Operator::LT:
+    return InfixState::INTEGER_LT;
+  case Operator::GT:
+    return InfixState::INTEGER_GT;
+  case Operator::EQ:
+    return InfixState::INTEGER_EQ;
+  case Operator::NOT_EQ:
+    return InfixState::INTEGER_NOT_EQ;
+  default:
+    return InfixState::GENERIC;
   }
-  return FALSE.get();
 }
 
-auto evaluate_prefix_expression(const std::string &operatr, obj::Object *right,
-                                const int line) -> obj::Object *
+// While an Infix only sees integers its state already names the operation,
+// so the one test left is that both operands still are integers. The first
+// time they aren't it goes GENERIC and takes the full path from then on.
+auto evaluate_infix(Infix *infix, obj::Environment *env) -> obj::Value
 {
-  if (operatr == "!") {
-    return evaluate_bang_operator_expression(right);
+  assert(infix->left && infix->right);
+  RootScope roots;
+  auto left = evaluate(infix->left, env);
+  if (returning.active()) {
+    return left;
+  }
+  roots.add(left);
+  auto right = evaluate(infix->right, env);
+  if (returning.active()) {
+    return right;
+  }
+
+  if (!left.is_integer() || !right.is_integer()) {
+    infix->state = InfixState::GENERIC;
+    return INFIX_HANDLERS[type_index(left.type())][type_index(right.type())](
+        infix->op, left, right, infix->token.line);
+  }
+
+  const auto left_value = left.as_integer();
+  const auto right_value = right.as_integer();
+  switch (infix->state) {
+  case InfixState::INTEGER_PLUS:
+    return obj::Value::make_integer(wrapping_add(left_value, right_value));
+  case InfixState::INTEGER_MINUS:
+    return obj::Value::make_integer(wrapping_sub(left_value, right_value));
+  case InfixState::INTEGER_MULTIPLICATION:
+    return obj::Value::make_integer(wrapping_mul(left_value, right_value));
+  case InfixState::INTEGER_DIVISION:
+    if (right_value != 0) {
+      return obj::Value::make_integer(wrapping_div(left_value, right_value));
+    }
+    break;
+  case InfixState::INTEGER_LT:
+    return to_boolean_object(left_value < right_value);
+  case InfixState::INTEGER_GT:
+    return to_boolean_object(left_value > right_value);
+  case InfixState::INTEGER_EQ:
+    return to_boolean_object(left_value == right_value);
+  case InfixState::INTEGER_NOT_EQ:
+    return to_boolean_object(left_value != right_value);
+  case InfixState::UNSEEN:
+    infix->state = integer_state(infix->op);
+    break;
+  case InfixState::GENERIC:
+    break;
+  }
+  return evaluate_integer_infix_expression(infix->op, left, right,
+                                           infix->token.line);
+}
+
+auto evaluate_prefix_expression(Operator op, obj::Value right, const int line)
+    -> obj::Value
+{
+  if (op == Operator::NEGATION) {
+    return is_truthy(right) ? FALSE : TRUE;
   }
-  if (operatr == "-") {
-    return evaluate_minus_operator_expression(right, line);
+  if (op == Operator::MINUS && right.is_integer()) {
+    return obj::Value::make_integer(wrapping_neg(right.as_integer()));
   }
 
-  auto *error = new obj::Error{fmt::format(UNKNOWN_PREFIX_OPERATION, operatr,
-                                           right->type_string(), line)};
-  eval_errors.push_back(error);
-
-  return error;
+  auto *error = heap.make<obj::Error>(
+      fmt::format(UNKNOWN_PREFIX_OPERATION, operator_string(op),
+                  right.type_string(), line));
+  return obj::Value::make_object(error);
 }
 
 auto evaluate_block_statements(Block *block, obj::Environment *env)
-    -> obj::Object *
+    -> obj::Value
 {
-  obj::Object *result = nullptr;
+  obj::Value result;
 
   for (auto *statement : block->statements) {
     result = evaluate(statement, env);
 
-    if (((result != nullptr) && result->type() == obj::ObjectType::RETURN) ||
-        result->type() == obj::ObjectType::ERROR) {
+    if (returning.active() || result.type() == obj::ObjectType::ERROR) {
       return result;
     }
   }
@@ -279,11 +484,13 @@ auto evaluate_block_statements(Block *block, obj::Environment *env)
 }
 
 auto evaluate_if_expression(If *if_expression, obj::Environment *env)
-    -> obj::Object *
+    -> obj::Value
 {
   assert(if_expression->condition);
-  auto *condicion = evaluate(if_expression->condition, env);
-  assert(condicion);
+  auto condicion = evaluate(if_expression->condition, env);
+  if (returning.active()) {
+    return condicion;
+  }
 
   if (is_truthy(condicion)) {
     assert(if_expression->consequence);
@@ -292,35 +499,52 @@ auto evaluate_if_expression(If *if_expression, obj::Environment *env)
   if (if_expression->alternative != nullptr) {
     return evaluate(if_expression->alternative, env);
   }
-  return _NULL.get();
+  return _NULL;
 }
 
 auto evaluate_loop_statement(LoopStatement *loop, obj::Environment *env)
-    -> obj::Object *
+    -> obj::Value
 {
   assert(loop->condition);
-  auto *condicion = evaluate(loop->condition, env);
-  assert(condicion);
+  while (true) {
+    heap.safe_point();
+    auto condicion = evaluate(loop->condition, env);
+    // a regresa only ends the current iteration, and so does an error in the
+    // body
+    if (returning.active()) {
+      returning.kind = ReturnSignal::Kind::NONE;
+      continue;
+    }
+    if (!is_truthy(condicion)) {
+      break;
+    }
 
-  if (is_truthy(condicion)) {
     evaluate(loop->repeat, env);
-    evaluate(loop, env);
+    returning.kind = ReturnSignal::Kind::NONE;
+    loop->back_edges++;
   }
 
-  return _NULL.get();
+  return _NULL;
 }
 
 auto evaluate_program(ast::Program *program, obj::Environment *env)
-    -> obj::Object *
+    -> obj::Value
 {
-  obj::Object *result = nullptr;
+  Optimizer optimizer;
+  optimizer.optimize_program(program);
+  Resolver resolver;
+  resolver.resolve_program(program, env->globals());
+
+  RootScope roots;
+  roots.add(env);
+  obj::Value result;
   for (auto *stm : program->statements) {
     result = evaluate(stm, env);
-    if (result->type() == obj::ObjectType::RETURN) {
-      auto *cast_result = static_cast<obj::Return *>(result);
-      return cast_result->value;
+    if (returning.active()) {
+      returning.kind = ReturnSignal::Kind::NONE;
+      return result;
     }
-    if (result->type() == obj::ObjectType::ERROR) {
+    if (result.type() == obj::ObjectType::ERROR) {
       return result;
     }
   }
@@ -328,62 +552,88 @@ auto evaluate_program(ast::Program *program, obj::Environment *env)
   return result;
 }
 
-inline auto extend_function_environment(obj::Function *fun,
-                                        const std::vector<obj::Object *> &args,
-                                        const int line) -> obj::Environment *
+auto extend_function_environment(obj::Function *fun,
+                                 const std::vector<obj::Value> &args,
+                                 obj::Environment *previous)
+    -> obj::Environment *
 {
-  if (fun->parameters.size() != args.size()) {
-    auto *error = new obj::Error{
-        fmt::format(WRONG_ARGS, line, fun->parameters.size(), args.size())};
-    eval_errors.push_back(error);
-    return nullptr;
+  auto *env = previous;
+  if (env != nullptr && env->reusable_for(fun->env, fun->scope)) {
+    env->reset();
+  }
+  else {
+    if (previous != nullptr) {
+      heap.release_frame(previous);
+    }
+    env = heap.make_frame(fun->env, fun->scope);
   }
-
-  auto *env = new obj::Environment(fun->env);
-  environments.push_back(env);
 
   for (std::size_t i = 0; i < fun->parameters.size(); i++) {
-    env->set_item(fun->parameters.at(i)->value, args.at(i));
+    env->set_slot(fun->parameters.at(i)->slot, args.at(i));
   }
 
   return env;
 }
 
-inline auto unwrap_return_value(obj::Object *obj) -> obj::Object *
+auto apply_function(obj::Value fun, std::vector<obj::Value> args, int line)
+    -> obj::Value
 {
-  if (obj->type() == obj::ObjectType::RETURN) {
-    return static_cast<obj::Return *>(obj)->value;
+  if (call_depth == 0) {
+    stack_budget.start();
   }
-  return obj;
-}
-
-auto apply_function(obj::Object *fun, const std::vector<obj::Object *> &args,
-                    const int line) -> obj::Object *
-{
-  if (fun->type() == obj::ObjectType::FUNCTION) {
-    auto *function = static_cast<obj::Function *>(fun);
-    auto *extended_environment =
-        extend_function_environment(function, args, line);
-    if (extended_environment == nullptr) {
-      return eval_errors.at(eval_errors.size() - 1UL);
+  const auto calls_left = std::min(max_call_depth - call_depth,
+                                   stack_budget.calls_left(call_depth));
+  if (fun.type() == obj::ObjectType::FUNCTION && calls_left == 0) {
+    auto *error =
+        heap.make<obj::Error>(fmt::format(STACK_OVERFLOW, line, call_depth));
+    return obj::Value::make_object(error);
+  }
+
+  CallDepthGuard depth;
+  obj::Environment *env = nullptr;
+  FrameScope frame(env);
+  // tail calls made by the body replace this call instead of nesting in it
+  while (fun.type() == obj::ObjectType::FUNCTION) {
+    auto *function = static_cast<obj::Function *>(fun.as_object());
+    if (function->parameters.size() != args.size()) {
+      auto *error = heap.make<obj::Error>(fmt::format(
+          WRONG_ARGS, line, function->parameters.size(), args.size()));
+      return obj::Value::make_object(error);
+    }
+    if (auto native = call_native(function, args, calls_left,
+                                  stack_budget.bytes_left())) {
+      return *native;
     }
 
-    auto *evaluated = evaluate(function->body, extended_environment);
-    return unwrap_return_value(evaluated);
+    RootScope roots;
+    roots.add(fun);
+    env = extend_function_environment(function, args, env);
+    roots.add(env);
+    heap.safe_point();
+
+    auto evaluated = evaluate(function->body, env);
+    if (returning.kind != ReturnSignal::Kind::TAIL_CALL) {
+      returning.kind = ReturnSignal::Kind::NONE;
+      return evaluated;
+    }
+    returning.kind = ReturnSignal::Kind::NONE;
+    fun = returning.callee;
+    args = std::move(returning.arguments);
+    line = returning.line;
   }
-  if (fun->type() == obj::ObjectType::BUILTIN) {
-    auto *function = static_cast<obj::Builtin *>(fun);
+
+  if (fun.type() == obj::ObjectType::BUILTIN) {
+    auto *function = static_cast<obj::Builtin *>(fun.as_object());
     return function->fn(args, line);
   }
 
-  auto *error =
-      new obj::Error{fmt::format(NOT_A_FUNCTION, fun->type_string(), line)};
-  eval_errors.push_back(error);
+  auto *error = heap.make<obj::Error>(
+      fmt::format(NOT_A_FUNCTION, fun.type_string(), line));
 
-  return error;
+  return obj::Value::make_object(error);
 }
 
-auto evaluate(ast::ASTNode *node, obj::Environment *env) -> obj::Object *
+auto evaluate(ast::ASTNode *node, obj::Environment *env) -> obj::Value
 {
   auto node_type = node->type();
 
@@ -399,9 +649,7 @@ auto evaluate(ast::ASTNode *node, obj::Environment *env) -> obj::Object *
 
   case Node::Integer: {
     auto *cast_int = static_cast<Integer *>(node);
-    auto *integer = new obj::Integer(cast_int->value);
-    cleaner.push_back(integer);
-    return integer;
+    return obj::Value::make_integer(static_cast<std::int64_t>(cast_int->value));
   }
 
   case Node::Boolean: {
@@ -412,20 +660,17 @@ auto evaluate(ast::ASTNode *node, obj::Environment *env) -> obj::Object *
   case Node::Prefix: {
     auto *cast_prefix = static_cast<Prefix *>(node);
     assert(cast_prefix != nullptr);
-    auto *right = evaluate(cast_prefix->right, env);
-    assert(right != nullptr);
-    return evaluate_prefix_expression(cast_prefix->operatr, right,
+    auto right = evaluate(cast_prefix->right, env);
+    if (returning.active()) {
+      return right;
+    }
+    return evaluate_prefix_expression(cast_prefix->op, right,
                                       cast_prefix->token.line);
   }
 
   case Node::Infix: {
     auto *cast_infix = static_cast<Infix *>(node);
-    assert(cast_infix->left && cast_infix->right);
-    auto *left = evaluate(cast_infix->left, env);
-    auto *right = evaluate(cast_infix->right, env);
-    assert(left && right);
-    return evaluate_infix_expression(cast_infix->operatr, left, right,
-                                     cast_infix->token.line);
+    return evaluate_infix(cast_infix, env);
   }
 
   case Node::Block: {
@@ -446,26 +691,51 @@ auto evaluate(ast::ASTNode *node, obj::Environment *env) -> obj::Object *
   case Node::ReturnStatement: {
     auto *cast_rtn_st = static_cast<ReturnStatement *>(node);
     assert(cast_rtn_st->return_value);
-    auto *value = evaluate(cast_rtn_st->return_value, env);
-    assert(value);
-    auto *return_val = new obj::Return(value);
-    cleaner.push_back(return_val);
-    return return_val;
+    if (cast_rtn_st->tail_call) {
+      auto *cast_call = static_cast<Call *>(cast_rtn_st->return_value);
+      RootScope roots;
+      auto function = evaluate(cast_call->function, env);
+      if (returning.active()) {
+        return function;
+      }
+      roots.add(function);
+      auto args = evaluate_expression(cast_call->arguments, env);
+      if (returning.active()) {
+        return args.back();
+      }
+      returning.kind = ReturnSignal::Kind::TAIL_CALL;
+      returning.callee = function;
+      returning.arguments = std::move(args);
+      returning.line = cast_call->token.line;
+      return _NULL;
+    }
+    auto value = evaluate(cast_rtn_st->return_value, env);
+    // a regresa inside the value already said how to leave
+    if (!returning.active()) {
+      returning.kind = ReturnSignal::Kind::VALUE;
+    }
+    return value;
   }
 
   case Node::LetStatement: {
     auto *cast_let_st = static_cast<LetStatement *>(node);
     assert(cast_let_st->value);
-    auto *value = evaluate(cast_let_st->value, env);
+    auto value = evaluate(cast_let_st->value, env);
+    if (returning.active()) {
+      return value;
+    }
     assert(cast_let_st->name);
-    env->set_item(cast_let_st->name->value, value);
+    env->set_slot(cast_let_st->name->slot, value);
     return value;
   }
 
   case Node::AssignStatement: {
     auto *cast_assign = static_cast<AssignStatement *>(node);
-    auto *value = evaluate(cast_assign->value, env);
-    env->set_item(cast_assign->name->value, value);
+    auto value = evaluate(cast_assign->value, env);
+    if (returning.active()) {
+      return value;
+    }
+    env->set_slot(cast_assign->name->slot, value);
     return value;
   }
 
@@ -478,29 +748,42 @@ auto evaluate(ast::ASTNode *node, obj::Environment *env) -> obj::Object *
   case Node::Function: {
     auto *cast_func = static_cast<Function *>(node);
     assert(cast_func);
-    auto *func = new obj::Function(cast_func->parameters, cast_func->body, env);
-    cleaner.push_back(func);
-    return func;
+    auto *func =
+        heap.make<obj::Function>(cast_func->parameters, cast_func->body,
+                                 &cast_func->scope, env);
+    return obj::Value::make_object(func);
   }
 
   case Node::Call: {
     auto *cast_call = static_cast<Call *>(node);
-    auto *function = evaluate(cast_call->function, env);
+    RootScope roots;
+    auto function = evaluate(cast_call->function, env);
+    if (returning.active()) {
+      return function;
+    }
+    if (cast_call->inlined != nullptr &&
+        function.type() == obj::ObjectType::FUNCTION &&
+        static_cast<obj::Function *>(function.as_object())->body ==
+            cast_call->inlined_body) {
+      return evaluate(cast_call->inlined, env);
+    }
+    roots.add(function);
     auto args = evaluate_expression(cast_call->arguments, env);
-    return apply_function(function, args, cast_call->token.line);
+    if (returning.active()) {
+      return args.back();
+    }
+    return apply_function(function, std::move(args), cast_call->token.line);
   }
 
   case Node::StringLiteral: {
     auto *cast_str_lit = static_cast<StringLiteral *>(node);
-    auto *str = new obj::String(cast_str_lit->value);
-    cleaner.push_back(str);
-    return str;
+    return obj::Value::make_object(literal_string(cast_str_lit));
   }
 
   case Node::Null:
-    return _NULL.get();
+    return _NULL;
 
   default:
-    return nullptr;
+    return _NULL;
   }
 }
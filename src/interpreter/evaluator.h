@@ -2,12 +2,16 @@
 #define EVALUATOR_H
 #include "ast.h"
 #include "builtin.h"
-#include "cleaner.h"
+#include "gc.h"
 #include "object.h"
+#include "symbol.h"
 #include "utils.h"
 #include <cassert>
 #include <cstddef>
+#include <cstdint>
 #include <fmt/format.h>
+#include <functional>
+#include <limits>
 #include <memory>
 #include <string>
 #include <string_view>
@@ -24,11 +28,119 @@ inline constexpr std::string_view UNKNOWN_PREFIX_OPERATION =
     "Operador desconocido: {}{} cerca de la línea {}";
 inline constexpr std::string_view UNKNOWN_INFIX_OPERATION =
     "Operador desconocido: {} {} {} cerca de la línea {}";
+inline constexpr std::string_view DIVISION_BY_ZERO =
+    "División entre cero: {} / 0 cerca de la línea {}";
+inline constexpr std::string_view STACK_OVERFLOW =
+    "Desbordamiento de pila cerca de la línea {}, se superaron {} llamadas "
+    "anidadas";
 
-/* NOLINT */ inline const auto TRUE = std::make_unique<obj::Boolean>(true);
-/* NOLINT */ inline const auto FALSE = std::make_unique<obj::Boolean>(false);
-/* NOLINT */ inline const auto _NULL = std::make_unique<obj::Null>();
+// without a limit set the tree-walking engines nest calls for as long as the
+// native stack has room, and the vm for DEFAULT_VM_MAX_CALL_DEPTH calls
+inline constexpr std::size_t NO_CALL_DEPTH_LIMIT =
+    std::numeric_limits<std::size_t>::max();
+// used when the stack of the running thread can't be found out
+inline constexpr std::size_t DEFAULT_NATIVE_STACK = 8UL * 1024UL * 1024UL;
+// stack kept for builtins, native code and expressions nested deeper than
+// usual, taken from the top of the stack left to the engines
+inline constexpr std::size_t NATIVE_STACK_RESERVE = 1024UL * 1024UL;
+// what the command line interpreter runs programs with
+inline constexpr std::size_t INTERPRETER_STACK = 256UL * 1024UL * 1024UL;
 
-auto evaluate(ast::ASTNode *node, obj::Environment *env) -> obj::Object *;
+// Every call nests several evaluate frames on the native stack, so the
+// tree-walking engines measure how much stack their calls have taken so far
+// and refuse the one that would no longer fit in what the thread has left.
+class StackBudget {
+  std::uintptr_t base = 0;
+  std::size_t room = 0;
+
+public:
+  // marks the stack the outermost call starts from
+  void start();
+  // how many more calls fit on top of depth nested ones, taking each to use
+  // as much stack as the ones so far did on average
+  [[nodiscard]] auto calls_left(std::size_t depth) const -> std::size_t;
+  // bytes of stack left before the reserve
+  [[nodiscard]] auto bytes_left() const -> std::size_t;
+};
+
+/* NOLINT */ inline constexpr auto TRUE = obj::Value::make_boolean(true);
+/* NOLINT */ inline constexpr auto FALSE = obj::Value::make_boolean(false);
+/* NOLINT */ inline constexpr auto _NULL = obj::Value();
+
+// Set while a regresa unwinds to the procedimiento, program or mientras
+// iteration it ends. The value it gives comes back as the result of every
+// evaluate on the way out, and nothing on the way goes on to use it. A call
+// in tail position is left here for the procedimiento's caller to make.
+struct ReturnSignal {
+  enum class Kind : std::uint8_t { NONE, VALUE, TAIL_CALL };
+
+  Kind kind = Kind::NONE;
+  obj::Value callee;
+  std::vector<obj::Value> arguments;
+  int line = 0;
+
+  [[nodiscard]] auto active() const -> bool { return kind != Kind::NONE; }
+};
+
+auto evaluate(ast::ASTNode *node, obj::Environment *env) -> obj::Value;
+auto evaluate_identifier(Symbol name, obj::Environment *env)
+    -> obj::Value;
+auto evaluate_infix_expression(ast::Operator op, obj::Value left,
+                               obj::Value right, int line) -> obj::Value;
+auto evaluate_prefix_expression(ast::Operator op, obj::Value right, int line)
+    -> obj::Value;
+// the environment of a call to fun, reusing previous when fun is making a
+// tail call back into itself
+auto extend_function_environment(obj::Function *fun,
+                                 const std::vector<obj::Value> &args,
+                                 obj::Environment *previous)
+    -> obj::Environment *;
+// for every engine created afterwards; NO_CALL_DEPTH_LIMIT restores the
+// defaults
+void set_max_call_depth(std::size_t depth);
+[[nodiscard]] auto get_max_call_depth() -> std::size_t;
+// runs work on a thread with stack_size bytes of stack, or on this one when
+// no thread can be made with it
+void run_with_stack(std::size_t stack_size, const std::function<void()> &work);
+
+inline auto is_truthy(const obj::Value value) -> bool
+{
+  if (value.is_null()) {
+    return false;
+  }
+  if (value.is_boolean()) {
+    return value.as_boolean();
+  }
+  return true;
+}
+
+// integer arithmetic wraps around on overflow instead of being undefined
+inline auto wrapping_add(std::int64_t left, std::int64_t right) -> std::int64_t
+{
+  return static_cast<std::int64_t>(static_cast<std::uint64_t>(left) +
+                                   static_cast<std::uint64_t>(right));
+}
+
+inline auto wrapping_sub(std::int64_t left, std::int64_t right) -> std::int64_t
+{
+  return static_cast<std::int64_t>(static_cast<std::uint64_t>(left) -
+                                   static_cast<std::uint64_t>(right));
+}
+
+inline auto wrapping_mul(std::int64_t left, std::int64_t right) -> std::int64_t
+{
+  return static_cast<std::int64_t>(static_cast<std::uint64_t>(left) *
+                                   static_cast<std::uint64_t>(right));
+}
+
+inline auto wrapping_neg(std::int64_t right) -> std::int64_t
+{
+  return wrapping_sub(0, right);
+}
+
+inline auto wrapping_div(std::int64_t left, std::int64_t right) -> std::int64_t
+{
+  return right == -1 ? wrapping_neg(left) : left / right;
+}
 
 #endif // EVALUATOR_H
@@ -0,0 +1,469 @@
+#include "flat.h"
+#include "ast.h"
+#include "evaluator.h"
+#include "gc.h"
+#include "object.h"
+#include "optimizer.h"
+#include "resolver.h"
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <fmt/format.h>
+#include <utility>
+#include <vector>
+
+using namespace ast;
+
+auto FlatTree::add(FlatNode node) -> std::uint32_t
+{
+  nodes.push_back(node);
+  return static_cast<std::uint32_t>(nodes.size() - 1);
+}
+
+auto FlatTree::add_constant(obj::Value value, int line) -> std::uint32_t
+{
+  constants.push_back(value);
+  return add({FlatKind::CONSTANT, 0, 0, line,
+              static_cast<std::uint32_t>(constants.size() - 1), 0});
+}
+
+// The statements are added before the block's own list, which goes at the
+// end of extra once none of them can add lists of their own in between.
+auto FlatTree::add_block(const std::vector<Statement *> &statements, int line)
+    -> std::uint32_t
+{
+  std::vector<std::uint32_t> children;
+  children.reserve(statements.size());
+  for (auto *statement : statements) {
+    children.push_back(add(statement));
+  }
+  const auto start = static_cast<std::uint32_t>(extra.size());
+  extra.insert(extra.end(), children.begin(), children.end());
+  return add({FlatKind::BLOCK, 0, 0, line, start,
+              static_cast<std::uint32_t>(children.size())});
+}
+
+auto FlatTree::add_program(Program *program) -> std::uint32_t
+{
+  return add_block(program->statements, 1);
+}
+
+auto FlatTree::add_body(Block *body) -> std::uint32_t
+{
+  return add_block(body->statements, body->token.line);
+}
+
+auto FlatTree::add(Statement *statement) -> std::uint32_t
+{
+  const auto line = statement->token.line;
+  switch (statement->type()) {
+
+  case Node::ExpressionStatement:
+    return add(static_cast<ExpressionStatement *>(statement)->expression);
+
+  case Node::Block:
+    return add_block(static_cast<Block *>(statement)->statements, line);
+
+  case Node::LetStatement: {
+    auto *cast_let_st = static_cast<LetStatement *>(statement);
+    const auto value = add(cast_let_st->value);
+    return add({FlatKind::ASSIGN, 0, 0, line,
+                static_cast<std::uint32_t>(cast_let_st->name->slot), value});
+  }
+
+  case Node::AssignStatement: {
+    auto *cast_assign = static_cast<AssignStatement *>(statement);
+    const auto value = add(cast_assign->value);
+    return add({FlatKind::ASSIGN, 0, 0, line,
+                static_cast<std::uint32_t>(cast_assign->name->slot), value});
+  }
+
+  case Node::ReturnStatement: {
+    auto *cast_rtn_st = static_cast<ReturnStatement *>(statement);
+    const auto value = add(cast_rtn_st->return_value);
+    return add({FlatKind::RETURN,
+                static_cast<std::uint8_t>(cast_rtn_st->tail_call ? 1 : 0), 0,
+                line, value, 0});
+  }
+
+  case Node::Loop: {
+    auto *cast_loop = static_cast<LoopStatement *>(statement);
+    const auto condition = add(cast_loop->condition);
+    const auto body = add(cast_loop->repeat);
+    const auto list = static_cast<std::uint32_t>(extra.size());
+    extra.push_back(body);
+    extra.push_back(static_cast<std::uint32_t>(loops.size()));
+    loops.push_back(cast_loop);
+    return add({FlatKind::LOOP, 0, 0, line, condition, list});
+  }
+
+  default:
+    return add({FlatKind::NIL, 0, 0, line, 0, 0});
+  }
+}
+
+auto FlatTree::add(Expression *expression) -> std::uint32_t
+{
+  const auto line = expression->token.line;
+  switch (expression->type()) {
+
+  case Node::Integer:
+    return add_constant(obj::Value::make_integer(static_cast<std::int64_t>(
+                            static_cast<Integer *>(expression)->value)),
+                        line);
+
+  case Node::StringLiteral:
+    return add_constant(obj::Value::make_object(literal_string(
+                            static_cast<StringLiteral *>(expression))),
+                        line);
+
+  case Node::Boolean:
+    return add({FlatKind::BOOLEAN, 0, 0, line,
+                static_cast<Boolean *>(expression)->value ? 1U : 0U, 0});
+
+  case Node::Prefix: {
+    auto *cast_prefix = static_cast<Prefix *>(expression);
+    const auto right = add(cast_prefix->right);
+    return add({FlatKind::PREFIX, static_cast<std::uint8_t>(cast_prefix->op),
+                0, line, right, 0});
+  }
+
+  case Node::Infix: {
+    auto *cast_infix = static_cast<Infix *>(expression);
+    const auto left = add(cast_infix->left);
+    const auto right = add(cast_infix->right);
+    return add({FlatKind::INFIX, static_cast<std::uint8_t>(cast_infix->op), 0,
+                line, left, right});
+  }
+
+  case Node::Identifier: {
+    auto *cast_ident = static_cast<Identifier *>(expression);
+    assert(cast_ident->depth <= UINT16_MAX);
+    return add({FlatKind::IDENTIFIER, 0,
+                static_cast<std::uint16_t>(cast_ident->depth), line,
+                static_cast<std::uint32_t>(cast_ident->slot),
+                cast_ident->symbol});
+  }
+
+  case Node::If: {
+    auto *cast_if = static_cast<If *>(expression);
+    const auto condition = add(cast_if->condition);
+    const auto consequence = add(cast_if->consequence);
+    const auto alternative = cast_if->alternative != nullptr
+                                 ? add(cast_if->alternative)
+                                 : NO_NODE;
+    const auto list = static_cast<std::uint32_t>(extra.size());
+    extra.push_back(consequence);
+    extra.push_back(alternative);
+    return add({FlatKind::IF, 0, 0, line, condition, list});
+  }
+
+  case Node::Function: {
+    auto *cast_func = static_cast<Function *>(expression);
+    const auto body = add_body(cast_func->body);
+    functions.push_back({cast_func, body});
+    return add({FlatKind::FUNCTION, 0, 0, line,
+                static_cast<std::uint32_t>(functions.size() - 1), 0});
+  }
+
+  case Node::Call: {
+    auto *cast_call = static_cast<Call *>(expression);
+    const auto callee = add(cast_call->function);
+    std::vector<std::uint32_t> arguments;
+    arguments.reserve(cast_call->arguments.size());
+    for (auto *argument : cast_call->arguments) {
+      arguments.push_back(add(argument));
+    }
+    const auto list = static_cast<std::uint32_t>(extra.size());
+    extra.push_back(static_cast<std::uint32_t>(arguments.size()));
+    extra.insert(extra.end(), arguments.begin(), arguments.end());
+    return add({FlatKind::CALL, 0, 0, line, callee, list});
+  }
+
+  default:
+    return add({FlatKind::NIL, 0, 0, line, 0, 0});
+  }
+}
+
+auto FlatEvaluator::run(Program *program, obj::Environment *env)
+    -> obj::Value
+{
+  Optimizer optimizer;
+  optimizer.optimize_program(program);
+  Resolver resolver;
+  resolver.resolve_program(program, env->globals());
+  const auto root = tree.node(tree.add_program(program));
+
+  RootScope roots;
+  roots.add(env);
+  obj::Value result;
+  for (std::uint32_t i = 0; i < root.second; i++) {
+    result = evaluate(tree.extra_at(root.first + i), env);
+    if (returning.active()) {
+      returning.kind = ReturnSignal::Kind::NONE;
+      return result;
+    }
+    if (result.type() == obj::ObjectType::ERROR) {
+      return result;
+    }
+  }
+
+  return result;
+}
+
+auto FlatEvaluator::evaluate_block(const FlatNode &block,
+                                   obj::Environment *env) -> obj::Value
+{
+  obj::Value result;
+  for (std::uint32_t i = 0; i < block.second; i++) {
+    result = evaluate(tree.extra_at(block.first + i), env);
+    if (returning.active() || result.type() == obj::ObjectType::ERROR) {
+      return result;
+    }
+  }
+  return result;
+}
+
+auto FlatEvaluator::evaluate_arguments(std::uint32_t list,
+                                       obj::Environment *env)
+    -> std::vector<obj::Value>
+{
+  const auto count = tree.extra_at(list);
+  auto result = std::vector<obj::Value>();
+  result.reserve(count);
+  for (std::uint32_t i = 1; i <= count; i++) {
+    result.push_back(evaluate(tree.extra_at(list + i), env));
+    // released by the RootScope of the call being evaluated
+    heap.push_root(result.back());
+    if (returning.active()) {
+      break;
+    }
+  }
+  return result;
+}
+
+auto FlatEvaluator::body(obj::Function *function) -> std::uint32_t
+{
+  if (function->flat_body == NO_NODE) {
+    function->flat_body = tree.add_body(function->body);
+  }
+  return function->flat_body;
+}
+
+auto FlatEvaluator::apply_function(obj::Value fun,
+                                   std::vector<obj::Value> args, int line)
+    -> obj::Value
+{
+  if (depth == 0) {
+    stack.start();
+  }
+  const auto calls_left =
+      std::min(max_depth - depth, stack.calls_left(depth));
+  if (fun.type() == obj::ObjectType::FUNCTION && calls_left == 0) {
+    auto *error =
+        heap.make<obj::Error>(fmt::format(STACK_OVERFLOW, line, depth));
+    return obj::Value::make_object(error);
+  }
+
+  depth++;
+  obj::Environment *env = nullptr;
+  FrameScope frame(env);
+  obj::Value result = _NULL;
+  bool returned = false;
+  // tail calls made by the body replace this call instead of nesting in it
+  while (fun.type() == obj::ObjectType::FUNCTION) {
+    auto *function = static_cast<obj::Function *>(fun.as_object());
+    if (function->parameters.size() != args.size()) {
+      auto *error = heap.make<obj::Error>(fmt::format(
+          WRONG_ARGS, line, function->parameters.size(), args.size()));
+      result = obj::Value::make_object(error);
+      returned = true;
+      break;
+    }
+
+    RootScope roots;
+    roots.add(fun);
+    env = extend_function_environment(function, args, env);
+    roots.add(env);
+    heap.safe_point();
+
+    const auto block = tree.node(body(function));
+    auto evaluated = evaluate_block(block, env);
+    if (returning.kind != ReturnSignal::Kind::TAIL_CALL) {
+      returning.kind = ReturnSignal::Kind::NONE;
+      result = evaluated;
+      returned = true;
+      break;
+    }
+    returning.kind = ReturnSignal::Kind::NONE;
+    fun = returning.callee;
+    args = std::move(returning.arguments);
+    line = returning.line;
+  }
+  depth--;
+  if (returned) {
+    return result;
+  }
+
+  if (fun.type() == obj::ObjectType::BUILTIN) {
+    auto *function = static_cast<obj::Builtin *>(fun.as_object());
+    return function->fn(args, line);
+  }
+
+  auto *error = heap.make<obj::Error>(
+      fmt::format(NOT_A_FUNCTION, fun.type_string(), line));
+  return obj::Value::make_object(error);
+}
+
+auto FlatEvaluator::evaluate(std::uint32_t index, obj::Environment *env)
+    -> obj::Value
+{
+  // a copy, since flattening a procedimiento on its first call can grow the
+  // node array under it
+  const auto node = tree.node(index);
+
+  switch (node.kind) {
+
+  case FlatKind::BLOCK:
+    return evaluate_block(node, env);
+
+  case FlatKind::CONSTANT:
+    return tree.constant(node.first);
+
+  case FlatKind::BOOLEAN:
+    return node.first != 0 ? TRUE : FALSE;
+
+  case FlatKind::NIL:
+    return _NULL;
+
+  case FlatKind::PREFIX: {
+    auto right = evaluate(node.first, env);
+    if (returning.active()) {
+      return right;
+    }
+    return evaluate_prefix_expression(static_cast<Operator>(node.flags), right,
+                                      node.line);
+  }
+
+  case FlatKind::INFIX: {
+    RootScope roots;
+    auto left = evaluate(node.first, env);
+    if (returning.active()) {
+      return left;
+    }
+    roots.add(left);
+    auto right = evaluate(node.second, env);
+    if (returning.active()) {
+      return right;
+    }
+    return evaluate_infix_expression(static_cast<Operator>(node.flags), left,
+                                     right, node.line);
+  }
+
+  case FlatKind::IDENTIFIER: {
+    auto *scope_env = env->ancestor(node.depth);
+    auto value = scope_env->get_slot(node.first);
+    if (!value.is_unset()) {
+      return value;
+    }
+    // not assigned yet in its own scope, so an outer one or a builtin may
+    // have it
+    return evaluate_identifier(node.second, scope_env->enclosing());
+  }
+
+  case FlatKind::ASSIGN: {
+    auto value = evaluate(node.second, env);
+    if (returning.active()) {
+      return value;
+    }
+    env->set_slot(node.first, value);
+    return value;
+  }
+
+  case FlatKind::IF: {
+    auto condition = evaluate(node.first, env);
+    if (returning.active()) {
+      return condition;
+    }
+    if (is_truthy(condition)) {
+      return evaluate(tree.extra_at(node.second), env);
+    }
+    const auto alternative = tree.extra_at(node.second + 1);
+    return alternative != NO_NODE ? evaluate(alternative, env) : _NULL;
+  }
+
+  case FlatKind::LOOP: {
+    const auto body = tree.extra_at(node.second);
+    auto *loop = tree.loop(tree.extra_at(node.second + 1));
+    while (true) {
+      heap.safe_point();
+      const auto condition = evaluate(node.first, env);
+      // a regresa only ends the current iteration, and so does an error in
+      // the body
+      if (returning.active()) {
+        returning.kind = ReturnSignal::Kind::NONE;
+        continue;
+      }
+      if (!is_truthy(condition)) {
+        break;
+      }
+      evaluate(body, env);
+      returning.kind = ReturnSignal::Kind::NONE;
+      loop->back_edges++;
+    }
+    return _NULL;
+  }
+
+  case FlatKind::RETURN: {
+    if (node.flags != 0) {
+      const auto call = tree.node(node.first);
+      RootScope roots;
+      auto function = evaluate(call.first, env);
+      if (returning.active()) {
+        return function;
+      }
+      roots.add(function);
+      auto args = evaluate_arguments(call.second, env);
+      if (returning.active()) {
+        return args.back();
+      }
+      returning.kind = ReturnSignal::Kind::TAIL_CALL;
+      returning.callee = function;
+      returning.arguments = std::move(args);
+      returning.line = call.line;
+      return _NULL;
+    }
+    auto value = evaluate(node.first, env);
+    // a regresa inside the value already said how to leave
+    if (!returning.active()) {
+      returning.kind = ReturnSignal::Kind::VALUE;
+    }
+    return value;
+  }
+
+  case FlatKind::FUNCTION: {
+    auto *source = tree.function(node.first);
+    auto *func = heap.make<obj::Function>(source->parameters, source->body,
+                                          &source->scope, env);
+    func->flat_body = tree.function_body(node.first);
+    return obj::Value::make_object(func);
+  }
+
+  case FlatKind::CALL: {
+    RootScope roots;
+    auto function = evaluate(node.first, env);
+    if (returning.active()) {
+      return function;
+    }
+    roots.add(function);
+    auto args = evaluate_arguments(node.second, env);
+    if (returning.active()) {
+      return args.back();
+    }
+    return apply_function(function, std::move(args), node.line);
+  }
+  }
+
+  return _NULL;
+}
@@ -0,0 +1,137 @@
+#ifndef FLAT_H
+#define FLAT_H
+#include "ast.h"
+#include "evaluator.h"
+#include "object.h"
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+enum class FlatKind : std::uint8_t {
+  // first: index into extra where its statements start, second: how many
+  BLOCK,
+  // first: index into constants
+  CONSTANT,
+  // first: 1 for verdadero, 0 for falso
+  BOOLEAN,
+  NIL,
+  // flags: the operator, first: the operand
+  PREFIX,
+  // flags: the operator, first and second: the operands
+  INFIX,
+  // depth: procedimientos out, first: slot, second: Symbol
+  IDENTIFIER,
+  // first: slot, second: the value
+  ASSIGN,
+  // first: condition, second: index into extra of the two branches
+  IF,
+  // first: condition, second: index into extra of the body and the loop
+  LOOP,
+  // flags: 1 for a tail call, first: the value
+  RETURN,
+  // first: index into functions
+  FUNCTION,
+  // first: the callee, second: index into extra of the argument count and
+  // the arguments
+  CALL,
+};
+
+// One node of a FlatTree. Children are indices into the same tree, and what
+// doesn't fit in two of them lives in its extra array.
+struct FlatNode {
+  FlatKind kind;
+  std::uint8_t flags;
+  std::uint16_t depth;
+  std::int32_t line;
+  std::uint32_t first;
+  std::uint32_t second;
+};
+static_assert(sizeof(FlatNode) == 16);
+
+inline constexpr std::uint32_t NO_NODE =
+    std::numeric_limits<std::uint32_t>::max();
+
+// The nodes of every program one FlatEvaluator ran, stored by value in
+// contiguous arrays so a walk over them reads memory in order instead of
+// chasing an ASTNode per child. Built from a program once the Optimizer and
+// the Resolver have been through it.
+class FlatTree {
+  struct FunctionSource {
+    ast::Function *function;
+    std::uint32_t body = NO_NODE;
+  };
+
+  std::vector<FlatNode> nodes;
+  std::vector<std::uint32_t> extra;
+  std::vector<obj::Value> constants;
+  std::vector<FunctionSource> functions;
+  std::vector<ast::LoopStatement *> loops;
+
+  auto add(FlatNode node) -> std::uint32_t;
+  auto add(ast::Statement *statement) -> std::uint32_t;
+  auto add(ast::Expression *expression) -> std::uint32_t;
+  auto add_block(const std::vector<ast::Statement *> &statements,
+                 int line) -> std::uint32_t;
+  auto add_constant(obj::Value value, int line) -> std::uint32_t;
+
+public:
+  // the block holding the program's statements
+  auto add_program(ast::Program *program) -> std::uint32_t;
+  // the body of a procedimiento that was never flattened, like one made by
+  // the tree-walking evaluator
+  auto add_body(ast::Block *body) -> std::uint32_t;
+
+  [[nodiscard]] auto node(std::uint32_t index) const -> const FlatNode &
+  {
+    return nodes[index];
+  }
+  [[nodiscard]] auto extra_at(std::uint32_t index) const -> std::uint32_t
+  {
+    return extra[index];
+  }
+  [[nodiscard]] auto constant(std::uint32_t index) const -> obj::Value
+  {
+    return constants[index];
+  }
+  [[nodiscard]] auto function(std::uint32_t index) const -> ast::Function *
+  {
+    return functions[index].function;
+  }
+  [[nodiscard]] auto function_body(std::uint32_t index) const
+      -> std::uint32_t
+  {
+    return functions[index].body;
+  }
+  [[nodiscard]] auto loop(std::uint32_t index) const -> ast::LoopStatement *
+  {
+    return loops[index];
+  }
+  [[nodiscard]] auto node_count() const -> std::size_t { return nodes.size(); }
+};
+
+// Runs programs on their FlatTree with the same semantics as the
+// tree-walking evaluator, whose operators, builtins and errors it shares.
+class FlatEvaluator {
+  FlatTree tree;
+  std::size_t depth = 0;
+  std::size_t max_depth = get_max_call_depth();
+  StackBudget stack;
+  ReturnSignal returning;
+
+  auto evaluate(std::uint32_t index, obj::Environment *env) -> obj::Value;
+  auto evaluate_block(const FlatNode &block, obj::Environment *env)
+      -> obj::Value;
+  auto evaluate_arguments(std::uint32_t list, obj::Environment *env)
+      -> std::vector<obj::Value>;
+  auto apply_function(obj::Value fun, std::vector<obj::Value> args, int line)
+      -> obj::Value;
+  auto body(obj::Function *function) -> std::uint32_t;
+
+public:
+  void set_max_depth(std::size_t max) { max_depth = max; }
+  auto run(ast::Program *program, obj::Environment *env) -> obj::Value;
+  [[nodiscard]] auto flat_tree() const -> const FlatTree & { return tree; }
+};
+
+#endif // FLAT_H
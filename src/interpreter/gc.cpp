@@ -0,0 +1,183 @@
+#include "gc.h"
+#include "object.h"
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+
+Heap::~Heap()
+{
+  for (const auto &allocation : objects) {
+    delete allocation.object;
+  }
+  for (auto *env : environments) {
+    delete env;
+  }
+}
+
+auto Heap::make_environment(obj::Environment *outer, const ast::Scope *scope)
+    -> obj::Environment *
+{
+  auto *env = new obj::Environment(outer, scope);
+  environments.push_back(env);
+  allocated += sizeof(obj::Environment);
+  return env;
+}
+
+auto Heap::make_frame(obj::Environment *outer, const ast::Scope *scope)
+    -> obj::Environment *
+{
+  if (scope->is_captured()) {
+    return make_environment(outer, scope);
+  }
+  if (free_frames.empty()) {
+    frames.push_back(std::make_unique<obj::Environment>(outer, scope));
+    frames.back()->pooled = true;
+    return frames.back().get();
+  }
+  auto *env = free_frames.back();
+  free_frames.pop_back();
+  env->reuse(outer, scope);
+  return env;
+}
+
+void Heap::release_frame(obj::Environment *env)
+{
+  if (env->pooled) {
+    free_frames.push_back(env);
+  }
+}
+
+auto Heap::intern(std::string_view text) -> obj::String *
+{
+  auto itr = interned.find(text);
+  if (itr != interned.end()) {
+    return itr->second.get();
+  }
+  auto str = std::make_unique<obj::String>(std::string(text));
+  str->seal();
+  auto *result = str.get();
+  interned.emplace(text, std::move(str));
+  return result;
+}
+
+void Heap::mark(obj::Value value)
+{
+  if (value.is_object()) {
+    mark(value.as_object());
+  }
+}
+
+void Heap::mark(obj::Object *object)
+{
+  if (object->mark != epoch) {
+    object->mark = epoch;
+    gray_objects.push_back(object);
+  }
+}
+
+void Heap::mark(obj::Environment *env)
+{
+  if (env != nullptr && env->mark != epoch) {
+    env->mark = epoch;
+    gray_environments.push_back(env);
+  }
+}
+
+void Heap::truncate_roots(std::size_t values, std::size_t envs)
+{
+  value_roots.resize(values);
+  environment_roots.resize(envs);
+}
+
+void Heap::add_source(const RootSource *source) { sources.push_back(source); }
+
+void Heap::remove_source(const RootSource *source)
+{
+  sources.erase(std::remove(sources.begin(), sources.end(), source),
+                sources.end());
+}
+
+void Heap::set_threshold(std::size_t bytes)
+{
+  threshold = bytes;
+  next_collection = bytes;
+}
+
+void Heap::trace()
+{
+  while (!gray_objects.empty() || !gray_environments.empty()) {
+    while (!gray_environments.empty()) {
+      auto *env = gray_environments.back();
+      gray_environments.pop_back();
+      for (const auto &value : env->values()) {
+        mark(value);
+      }
+      mark(env->enclosing());
+    }
+
+    while (!gray_objects.empty()) {
+      auto *object = gray_objects.back();
+      gray_objects.pop_back();
+      switch (object->type()) {
+      case obj::ObjectType::FUNCTION:
+        mark(static_cast<obj::Function *>(object)->env);
+        break;
+      default:
+        break;
+      }
+    }
+  }
+}
+
+void Heap::sweep()
+{
+  allocated = 0;
+  auto live_objects = std::partition(
+      objects.begin(), objects.end(),
+      [this](const Allocation &allocation) {
+        return allocation.object->mark == epoch;
+      });
+  for (auto itr = live_objects; itr != objects.end(); itr++) {
+    delete itr->object;
+  }
+  objects.erase(live_objects, objects.end());
+  for (const auto &allocation : objects) {
+    allocated += allocation.size;
+  }
+
+  auto live_envs =
+      std::partition(environments.begin(), environments.end(),
+                     [this](const obj::Environment *env) {
+                       return env->mark == epoch;
+                     });
+  for (auto itr = live_envs; itr != environments.end(); itr++) {
+    delete *itr;
+  }
+  environments.erase(live_envs, environments.end());
+  allocated += environments.size() * sizeof(obj::Environment);
+}
+
+void Heap::collect()
+{
+  // a fresh epoch makes every mark from the previous cycle stale, including
+  // the ones left on objects the heap doesn't own such as the builtins
+  if (++epoch == 0) {
+    epoch = 1;
+  }
+
+  for (const auto &value : value_roots) {
+    mark(value);
+  }
+  for (auto *env : environment_roots) {
+    mark(env);
+  }
+  for (const auto *source : sources) {
+    source->trace_roots(*this);
+  }
+  trace();
+  sweep();
+
+  next_collection = std::max(threshold, allocated * GC_GROWTH_FACTOR);
+}
@@ -0,0 +1,185 @@
+#ifndef GC_H
+#define GC_H
+#include "object.h"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+inline constexpr std::size_t DEFAULT_GC_THRESHOLD = 1024UL * 1024UL;
+inline constexpr std::size_t GC_GROWTH_FACTOR = 2;
+
+class Heap;
+
+// anything holding values outside of the evaluator's own roots, like the VM
+// stack, registers itself so a collection can see them
+class RootSource {
+public:
+  virtual void trace_roots(Heap &gc) const = 0;
+  virtual ~RootSource() = default;
+  RootSource() = default;
+  RootSource(const RootSource &) = delete;
+  auto operator=(const RootSource &) -> RootSource & = delete;
+  RootSource(RootSource &&) = delete;
+  auto operator=(RootSource &&) -> RootSource & = delete;
+};
+
+// Mark and sweep collector for every obj::Object and obj::Environment created
+// while running a program. Collections only happen at safe points (loop
+// iterations and function calls), so a value returned by evaluate stays valid
+// until the next program runs.
+class Heap {
+  struct Allocation {
+    obj::Object *object;
+    std::size_t size;
+  };
+
+  std::vector<Allocation> objects;
+  std::vector<obj::Environment *> environments;
+  // environments of calls that can't create a closure, so nothing outlives
+  // the call that needs them: they go back to free_frames when it ends
+  std::vector<std::unique_ptr<obj::Environment>> frames;
+  std::vector<obj::Environment *> free_frames;
+  std::vector<obj::Value> value_roots;
+  std::vector<obj::Environment *> environment_roots;
+  std::vector<const RootSource *> sources;
+  // never swept
+  std::map<std::string, std::unique_ptr<obj::String>, std::less<>> interned;
+  std::vector<obj::Object *> gray_objects;
+  std::vector<obj::Environment *> gray_environments;
+  std::uint32_t epoch = 0;
+  std::size_t allocated = 0;
+  std::size_t threshold = DEFAULT_GC_THRESHOLD;
+  std::size_t next_collection = DEFAULT_GC_THRESHOLD;
+
+  void trace();
+  void sweep();
+
+public:
+  Heap() = default;
+  Heap(const Heap &) = delete;
+  auto operator=(const Heap &) -> Heap & = delete;
+  Heap(Heap &&) = delete;
+  auto operator=(Heap &&) -> Heap & = delete;
+  ~Heap();
+
+  template <class T, class... Args> auto make(Args &&...args) -> T *
+  {
+    auto *object = new T(std::forward<Args>(args)...);
+    auto size = sizeof(T);
+    if constexpr (std::is_same_v<T, obj::String>) {
+      size += object->buffer_bytes();
+    }
+    objects.push_back({object, size});
+    allocated += size;
+    return object;
+  }
+  auto make_environment(obj::Environment *outer, const ast::Scope *scope)
+      -> obj::Environment *;
+  // the environment for a call with this scope, from the frame pool when no
+  // procedimiento is created in that scope and from the heap otherwise
+  auto make_frame(obj::Environment *outer, const ast::Scope *scope)
+      -> obj::Environment *;
+  // hands a frame back when its call ends; environments from the heap are
+  // left to the collector
+  void release_frame(obj::Environment *env);
+  // the one String holding text, for literals: it is shared by every
+  // program and lives as long as the heap, so its count stays bounded by the
+  // distinct literals ever run
+  auto intern(std::string_view text) -> obj::String *;
+
+  void mark(obj::Value value);
+  void mark(obj::Object *object);
+  void mark(obj::Environment *env);
+
+  void push_root(obj::Value value) { value_roots.push_back(value); }
+  void push_root(obj::Environment *env) { environment_roots.push_back(env); }
+  void truncate_roots(std::size_t values, std::size_t envs);
+  [[nodiscard]] auto value_root_count() const -> std::size_t
+  {
+    return value_roots.size();
+  }
+  [[nodiscard]] auto environment_root_count() const -> std::size_t
+  {
+    return environment_roots.size();
+  }
+
+  void add_source(const RootSource *source);
+  void remove_source(const RootSource *source);
+
+  void set_threshold(std::size_t bytes);
+  void safe_point()
+  {
+    if (allocated >= next_collection) {
+      collect();
+    }
+  }
+  void collect();
+
+  [[nodiscard]] auto allocated_bytes() const -> std::size_t
+  {
+    return allocated;
+  }
+  [[nodiscard]] auto object_count() const -> std::size_t
+  {
+    return objects.size() + environments.size();
+  }
+};
+
+inline Heap heap; // NOLINT
+
+// the interned String of a literal, looked up once per node
+inline auto literal_string(ast::StringLiteral *literal) -> obj::String *
+{
+  if (literal->interned == nullptr) {
+    literal->interned = heap.intern(literal->value);
+  }
+  return literal->interned;
+}
+
+// keeps values that only live in C++ locals reachable until the scope ends
+class RootScope {
+  std::size_t values;
+  std::size_t envs;
+
+public:
+  RootScope()
+      : values(heap.value_root_count()), envs(heap.environment_root_count())
+  {
+  }
+  RootScope(const RootScope &) = delete;
+  auto operator=(const RootScope &) -> RootScope & = delete;
+  RootScope(RootScope &&) = delete;
+  auto operator=(RootScope &&) -> RootScope & = delete;
+  ~RootScope() { heap.truncate_roots(values, envs); }
+
+  void add(obj::Value value) { heap.push_root(value); }
+  void add(obj::Environment *env) { heap.push_root(env); }
+};
+
+// hands the frame of a call back to the heap however the call ends; env
+// follows the call through its tail calls
+class FrameScope {
+  obj::Environment *&env;
+
+public:
+  explicit FrameScope(obj::Environment *&frame) : env(frame) {}
+  FrameScope(const FrameScope &) = delete;
+  auto operator=(const FrameScope &) -> FrameScope & = delete;
+  FrameScope(FrameScope &&) = delete;
+  auto operator=(FrameScope &&) -> FrameScope & = delete;
+  ~FrameScope()
+  {
+    if (env != nullptr) {
+      heap.release_frame(env);
+    }
+  }
+};
+
+#endif // GC_H
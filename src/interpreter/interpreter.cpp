@@ -1,14 +1,18 @@
 #include "interpreter.h"
 #include "ast.h"
 #include "evaluator.h"
+#include "flat.h"
 #include "lexer.h"
 #include "object.h"
 #include "parser.h"
+#include "source.h"
 #include "token.h"
+#include "vm.h"
 #include <fmt/core.h>
 #include <iostream>
 #include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
 using namespace std;
@@ -24,22 +28,41 @@ auto main_print_parser_errors(const vector<string> &errors) -> string
   return result;
 }
 
-auto interprete_code(const string &code) -> string
+auto interprete_code(const string &code, Engine engine) -> string
+{
+  // the code outlives every node parsed from it
+  return interprete_code(SourceBuffer::borrow(code), engine);
+}
+
+auto interprete_code(shared_ptr<const SourceBuffer> source, Engine engine)
+    -> string
 {
   auto env = make_unique<Environment>();
   Programs_Guard guard;
 
-  Lexer lexer(code);
+  Lexer lexer(std::move(source));
   Parser parser(lexer);
-  auto *program = guard.new_program(parser.parse_program());
+  auto statements = parser.parse_program();
+  auto *program = guard.new_program(statements, parser.take_arena());
   if (!parser.errors().empty()) {
     return main_print_parser_errors(parser.errors());
   }
 
-  auto *evaluated = evaluate(program, env.get());
+  obj::Value evaluated;
+  if (engine == Engine::VM) {
+    VM machine;
+    evaluated = machine.run(program, env.get());
+  }
+  else if (engine == Engine::FLAT) {
+    FlatEvaluator flat;
+    evaluated = flat.run(program, env.get());
+  }
+  else {
+    evaluated = evaluate(program, env.get());
+  }
 
-  if (evaluated != nullptr) {
-    return fmt::format("{}", evaluated->inspect());
+  if (!program->statements.empty()) {
+    return fmt::format("{}", evaluated.inspect());
   }
 
   return "";
@@ -1,6 +1,12 @@
 #ifndef INTERPRETER_H
 #define INTERPRETER_H
 #include "evaluator.h"
+#include "source.h"
+#include "vm.h"
+#include <memory>
 #include <string>
-auto interprete_code(const std::string &) -> std::string;
+auto interprete_code(const std::string &, Engine engine = Engine::AST)
+    -> std::string;
+auto interprete_code(std::shared_ptr<const SourceBuffer> source,
+                     Engine engine = Engine::AST) -> std::string;
 #endif // !INTERPRETER_H
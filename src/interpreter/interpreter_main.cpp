@@ -1,4 +1,84 @@
+#include "evaluator.h"
+#include "gc.h"
+#include "interpreter.h"
 #include "repl.h"
+#include "source.h"
+#include "vm.h"
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <cstdlib>
+#include <fmt/core.h>
 #include <iostream>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
 
-auto main() -> int { start_repl(); }
+static constexpr std::string_view ENGINE_OPTION = "--engine=";
+static constexpr std::string_view GC_THRESHOLD_OPTION = "--gc-threshold=";
+static constexpr std::string_view MAX_DEPTH_OPTION = "--max-depth=";
+
+auto main(int argc, char *argv[]) -> int
+{
+  auto engine = Engine::AST;
+  std::string file_name;
+
+  const auto args = std::vector<std::string_view>(argv + 1, argv + argc);
+  for (const auto &arg : args) {
+    if (arg.starts_with(ENGINE_OPTION)) {
+      const auto name = arg.substr(ENGINE_OPTION.size());
+      const auto *pos =
+          std::find_if(engines_enums_strings.begin(),
+                       engines_enums_strings.end(),
+                       [&name](const auto &pair) { return pair.name == name; });
+      if (pos == engines_enums_strings.end()) {
+        std::cerr << fmt::format("Motor desconocido: {}\n", name);
+        return EXIT_FAILURE;
+      }
+      engine = pos->value;
+    }
+    else if (arg.starts_with(GC_THRESHOLD_OPTION)) {
+      const auto bytes = arg.substr(GC_THRESHOLD_OPTION.size());
+      std::size_t threshold = 0;
+      const auto [ptr, ec] = std::from_chars(
+          bytes.data(), bytes.data() + bytes.size(), threshold);
+      if (ec != std::errc() || ptr != bytes.data() + bytes.size()) {
+        std::cerr << fmt::format("Umbral de memoria inválido: {}\n", bytes);
+        return EXIT_FAILURE;
+      }
+      heap.set_threshold(threshold);
+    }
+    else if (arg.starts_with(MAX_DEPTH_OPTION)) {
+      const auto calls = arg.substr(MAX_DEPTH_OPTION.size());
+      std::size_t depth = 0;
+      const auto [ptr, ec] = std::from_chars(
+          calls.data(), calls.data() + calls.size(), depth);
+      if (ec != std::errc() || ptr != calls.data() + calls.size()) {
+        std::cerr << fmt::format("Profundidad máxima inválida: {}\n", calls);
+        return EXIT_FAILURE;
+      }
+      set_max_call_depth(depth);
+    }
+    else {
+      file_name = arg;
+    }
+  }
+
+  // the tree-walking engines recurse on the native stack, so programs get a
+  // thread with room for far deeper recursion than the main one has
+  if (file_name.empty()) {
+    run_with_stack(INTERPRETER_STACK, [engine] { start_repl(engine); });
+    return EXIT_SUCCESS;
+  }
+
+  auto source = SourceBuffer::map_file(file_name);
+  if (source == nullptr) {
+    std::cerr << fmt::format("No se pudo abrir el archivo: {}\n", file_name);
+    return EXIT_FAILURE;
+  }
+  run_with_stack(INTERPRETER_STACK, [&source, engine] {
+    fmt::print("{}\n", interprete_code(source, engine));
+  });
+  return EXIT_SUCCESS;
+}
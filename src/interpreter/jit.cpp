@@ -0,0 +1,867 @@
+#include "jit.h"
+#include "ast.h"
+#include "object.h"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#ifdef MIMIR_HAS_JIT
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+using namespace ast;
+
+static std::size_t jit_threshold = DEFAULT_JIT_THRESHOLD; // NOLINT
+
+void set_jit_threshold(std::size_t calls) { jit_threshold = calls; }
+
+// What an expression leaves in rax. NONE is for code that never finishes
+// because it jumps away, like a regresa, and MIXED for a si whose branches
+// give different types, which is only fine when nothing reads it.
+enum class NativeType { NONE, INT, BOOL, NIL, MIXED };
+
+class JitFunction {
+public:
+  enum class State { COUNTING, COMPILED, REJECTED };
+
+  State state = State::COUNTING;
+  std::size_t calls = 0;
+  std::size_t bails = 0;
+  NativeType result = NativeType::NONE;
+  // depth from the procedimiento's environment and slot of every name it
+  // calls itself by
+  std::vector<std::pair<std::size_t, std::size_t>> self_references;
+  void *code = nullptr;
+  std::size_t code_size = 0;
+
+  JitFunction() = default;
+  JitFunction(const JitFunction &) = delete;
+  auto operator=(const JitFunction &) -> JitFunction & = delete;
+  JitFunction(JitFunction &&) = delete;
+  auto operator=(JitFunction &&) -> JitFunction & = delete;
+  ~JitFunction()
+  {
+#ifdef MIMIR_HAS_JIT
+    if (code != nullptr) {
+      munmap(code, code_size);
+    }
+#endif
+  }
+};
+
+auto has_native_code(const obj::Function *fun) -> bool
+{
+  return fun->body->native != nullptr &&
+         fun->body->native->state == JitFunction::State::COMPILED;
+}
+
+#ifdef MIMIR_HAS_JIT
+
+// a procedimiento goes back to being evaluated after this many bail outs
+static constexpr std::size_t MAX_BAILS = 8;
+// the most nested calls native code makes, whatever the evaluator's limit
+static constexpr std::size_t MAX_NATIVE_DEPTH = 1UL << 20UL;
+// arguments are passed in a fixed array
+static constexpr std::size_t MAX_NATIVE_PARAMETERS = 8;
+
+// filled in by the entry code
+struct NativeContext {
+  std::int64_t saved_rsp;
+  std::int64_t depth_budget;
+  std::int64_t bailed;
+  // the lowest rsp a body may start from, so native calls bail out before
+  // they take the stack the evaluator keeps in reserve
+  std::int64_t stack_limit;
+};
+
+using NativeEntry = std::int64_t (*)(const std::int64_t *, NativeContext *);
+
+// Bytes of x86-64 code with forward jumps to labels patched in at the end.
+class Assembler {
+  static constexpr std::size_t UNBOUND = SIZE_MAX;
+
+  struct Patch {
+    std::size_t at;
+    std::size_t label;
+  };
+
+  std::vector<std::uint8_t> bytes;
+  std::vector<std::size_t> labels;
+  std::vector<Patch> patches;
+
+public:
+  void emit(std::initializer_list<std::uint8_t> code)
+  {
+    bytes.insert(bytes.end(), code);
+  }
+  template <class T> void emit_value(T value)
+  {
+    std::array<std::uint8_t, sizeof(T)> raw{};
+    std::memcpy(raw.data(), &value, sizeof(T));
+    bytes.insert(bytes.end(), raw.begin(), raw.end());
+  }
+  auto new_label() -> std::size_t
+  {
+    labels.push_back(UNBOUND);
+    return labels.size() - 1;
+  }
+  void bind(std::size_t label) { labels.at(label) = bytes.size(); }
+  void rel32(std::size_t label)
+  {
+    patches.push_back({bytes.size(), label});
+    emit_value<std::int32_t>(0);
+  }
+  auto finish() -> std::vector<std::uint8_t>
+  {
+    for (const auto &patch : patches) {
+      const auto target = static_cast<std::int64_t>(labels.at(patch.label));
+      const auto offset = static_cast<std::int32_t>(
+          target - static_cast<std::int64_t>(patch.at + 4));
+      std::memcpy(&bytes.at(patch.at), &offset, sizeof(offset));
+    }
+    return std::move(bytes);
+  }
+};
+
+// Compiles one procedimiento, or finds it can't. The entry code saves the
+// callee-saved registers and rsp in the NativeContext, pushes the arguments
+// and calls the body. A body keeps its slots below rbp, rax holds the value
+// of the expression just compiled, rcx the right operand of an infix, rbx
+// the context and r12 how many nested calls are left. Every body checks rsp
+// against the context's stack limit once it has made room for its slots.
+// Failing checks jump to
+// a bail out that restores rsp from the context and returns from the entry
+// code at once, however deep the native calls went.
+class NativeCompiler {
+  struct Loop {
+    std::size_t head;
+    std::size_t temps;
+  };
+
+  Assembler code;
+  obj::Function *function;
+  JitFunction &jit;
+  std::vector<NativeType> slot_types;
+  // slots certainly assigned by the code compiled so far
+  std::vector<bool> assigned;
+  std::vector<Loop> loops;
+  // values pushed and not popped yet
+  std::size_t temps = 0;
+  bool calls_itself = false;
+  bool ok = true;
+  std::size_t body = 0;
+  std::size_t start = 0;
+  std::size_t exit = 0;
+  std::size_t bail = 0;
+
+  void reject() { ok = false; }
+  static auto readable(NativeType type) -> bool
+  {
+    return type == NativeType::INT || type == NativeType::BOOL ||
+           type == NativeType::NIL;
+  }
+  static auto join(NativeType left, NativeType right) -> NativeType
+  {
+    if (left == NativeType::NONE) {
+      return right;
+    }
+    if (right == NativeType::NONE || left == right) {
+      return left;
+    }
+    return NativeType::MIXED;
+  }
+  static auto slot_offset(std::size_t slot) -> std::int32_t
+  {
+    return -8 * static_cast<std::int32_t>(slot + 1);
+  }
+
+  void load(std::size_t slot)
+  {
+    code.emit({0x48, 0x8B, 0x85}); // mov rax, [rbp + disp32]
+    code.emit_value(slot_offset(slot));
+  }
+  void store(std::size_t slot)
+  {
+    code.emit({0x48, 0x89, 0x85}); // mov [rbp + disp32], rax
+    code.emit_value(slot_offset(slot));
+  }
+  void set_rax(std::int64_t value)
+  {
+    if (value == 0) {
+      code.emit({0x31, 0xC0}); // xor eax, eax
+      return;
+    }
+    code.emit({0x48, 0xB8}); // mov rax, imm64
+    code.emit_value(value);
+  }
+  void push_rax()
+  {
+    code.emit({0x50});
+    temps++;
+  }
+  void pop_rax()
+  {
+    code.emit({0x58});
+    temps--;
+  }
+  void jump(std::size_t label)
+  {
+    code.emit({0xE9});
+    code.rel32(label);
+  }
+  void jump_if_rax_zero(std::size_t label)
+  {
+    code.emit({0x48, 0x85, 0xC0, 0x0F, 0x84}); // test rax, rax; jz
+    code.rel32(label);
+  }
+  // leaves the temporaries above temps on the stack before jumping away
+  void drop_temps(std::size_t down_to)
+  {
+    if (temps > down_to) {
+      code.emit({0x48, 0x81, 0xC4}); // add rsp, imm32
+      code.emit_value(static_cast<std::int32_t>(8 * (temps - down_to)));
+    }
+  }
+
+  void emit_entry();
+  void emit_body();
+  auto self_call(Call *call) -> bool;
+  auto push_arguments(Call *call) -> NativeType;
+  auto compile_block(const std::vector<Statement *> &statements)
+      -> NativeType;
+  auto compile_branch(Block *block) -> NativeType;
+  auto compile(Statement *statement) -> NativeType;
+  auto compile_return(ReturnStatement *return_statement) -> NativeType;
+  auto compile_loop(LoopStatement *loop) -> NativeType;
+  auto compile(Expression *expression) -> NativeType;
+  auto compile_prefix(Prefix *prefix) -> NativeType;
+  auto compile_infix(Infix *infix) -> NativeType;
+  auto compile_integer_infix(Operator op) -> NativeType;
+  auto compile_if(If *if_expression) -> NativeType;
+
+public:
+  NativeCompiler(obj::Function *fun, JitFunction &target)
+      : function(fun), jit(target),
+        slot_types(fun->scope->size(), NativeType::NONE),
+        assigned(fun->scope->size(), false)
+  {
+  }
+  auto compile() -> std::vector<std::uint8_t>;
+};
+
+auto NativeCompiler::compile() -> std::vector<std::uint8_t>
+{
+  if (function->parameters.size() > MAX_NATIVE_PARAMETERS) {
+    return {};
+  }
+  body = code.new_label();
+  start = code.new_label();
+  exit = code.new_label();
+  bail = code.new_label();
+
+  emit_entry();
+  emit_body();
+
+  // the value of a call to itself was taken to be an integer
+  if (!ok || jit.result == NativeType::NONE ||
+      jit.result == NativeType::MIXED ||
+      (calls_itself && jit.result != NativeType::INT)) {
+    return {};
+  }
+  return code.finish();
+}
+
+void NativeCompiler::emit_entry()
+{
+  const auto done = code.new_label();
+
+  code.emit({0x55, 0x53, 0x41, 0x54}); // push rbp; push rbx; push r12
+  code.emit({0x48, 0x89, 0xF3});       // mov rbx, rsi
+  code.emit({0x4C, 0x8B, 0x63, 0x08}); // mov r12, [rbx + 8]
+  code.emit({0x48, 0x89, 0x23});       // mov [rbx], rsp
+  for (std::size_t i = 0; i < function->parameters.size(); i++) {
+    code.emit({0xFF, 0xB7}); // push qword [rdi + disp32]
+    code.emit_value(static_cast<std::int32_t>(8 * i));
+  }
+  code.emit({0xE8}); // call body
+  code.rel32(body);
+  code.emit({0x48, 0xC7, 0x43, 0x10}); // mov qword [rbx + 16], 0
+  code.emit_value<std::int32_t>(0);
+  code.bind(done);
+  code.emit({0x41, 0x5C, 0x5B, 0x5D, 0xC3}); // pop r12; pop rbx; pop rbp; ret
+
+  code.bind(bail);
+  code.emit({0x48, 0x8B, 0x23});       // mov rsp, [rbx]
+  code.emit({0x48, 0xC7, 0x43, 0x10}); // mov qword [rbx + 16], 1
+  code.emit_value<std::int32_t>(1);
+  jump(done);
+}
+
+void NativeCompiler::emit_body()
+{
+  const auto &parameters = function->parameters;
+  const auto count = parameters.size();
+
+  code.bind(body);
+  code.emit({0x55, 0x48, 0x89, 0xE5}); // push rbp; mov rbp, rsp
+  code.emit({0x48, 0x81, 0xEC});       // sub rsp, imm32
+  code.emit_value(static_cast<std::int32_t>(8 * slot_types.size()));
+  code.emit({0x48, 0x3B, 0x63, 0x18, 0x0F, 0x82}); // cmp rsp, [rbx + 24]; jb
+  code.rel32(bail);
+  for (std::size_t i = 0; i < count; i++) {
+    const auto slot = parameters.at(i)->slot;
+    if (slot >= slot_types.size()) {
+      reject();
+      return;
+    }
+    // the caller pushed them in order, so the last one is nearest
+    code.emit({0x48, 0x8B, 0x85}); // mov rax, [rbp + disp32]
+    code.emit_value(static_cast<std::int32_t>(16 + 8 * (count - 1 - i)));
+    store(slot);
+    slot_types.at(slot) = NativeType::INT;
+    assigned.at(slot) = true;
+  }
+  code.emit({0x49, 0xFF, 0xCC, 0x0F, 0x88}); // dec r12; js bail
+  code.rel32(bail);
+
+  code.bind(start);
+  const auto type = compile_block(function->body->statements);
+  if (type == NativeType::MIXED) {
+    reject();
+  }
+  jit.result = join(jit.result, type);
+
+  code.bind(exit);
+  code.emit({0x49, 0xFF, 0xC4});       // inc r12
+  code.emit({0x48, 0x89, 0xEC, 0x5D}); // mov rsp, rbp; pop rbp
+  if (count == 0) {
+    code.emit({0xC3});
+  }
+  else {
+    code.emit({0xC2}); // ret imm16, dropping the arguments
+    code.emit_value(static_cast<std::uint16_t>(8 * count));
+  }
+}
+
+// Only calls through a name that, right now, holds this same procedimiento.
+// They can't change while native code runs, since it assigns nothing but its
+// own slots, so call_native checks them again before every run.
+auto NativeCompiler::self_call(Call *call) -> bool
+{
+  if (call->function->type() != Node::Identifier ||
+      call->arguments.size() != function->parameters.size()) {
+    return false;
+  }
+  auto *name = static_cast<Identifier *>(call->function);
+  if (name->depth == 0 || name->slot == UNRESOLVED_SLOT ||
+      function->env == nullptr) {
+    return false;
+  }
+  const auto reference = std::make_pair(name->depth - 1, name->slot);
+  const auto value =
+      function->env->ancestor(reference.first)->get_slot(reference.second);
+  if (!value.is_object() || value.as_object() != function) {
+    return false;
+  }
+  auto &references = jit.self_references;
+  if (std::find(references.begin(), references.end(), reference) ==
+      references.end()) {
+    references.push_back(reference);
+  }
+  return true;
+}
+
+auto NativeCompiler::push_arguments(Call *call) -> NativeType
+{
+  const auto outer = temps;
+  for (auto *argument : call->arguments) {
+    const auto type = compile(argument);
+    if (type == NativeType::NONE) {
+      // the rest is never reached, so neither are the pushes
+      temps = outer;
+      return type;
+    }
+    if (type != NativeType::INT) {
+      reject();
+    }
+    push_rax();
+  }
+  return NativeType::INT;
+}
+
+auto NativeCompiler::compile_block(const std::vector<Statement *> &statements)
+    -> NativeType
+{
+  if (statements.empty()) {
+    set_rax(0);
+    return NativeType::NIL;
+  }
+  auto type = NativeType::NIL;
+  for (auto *statement : statements) {
+    type = compile(statement);
+    // what follows can't run
+    if (type == NativeType::NONE || !ok) {
+      break;
+    }
+  }
+  return type;
+}
+
+// slots first assigned in a branch may be unset after it
+auto NativeCompiler::compile_branch(Block *block) -> NativeType
+{
+  const auto outer = assigned;
+  const auto type = compile_block(block->statements);
+  assigned = outer;
+  return type;
+}
+
+auto NativeCompiler::compile(Statement *statement) -> NativeType
+{
+  switch (statement->type()) {
+
+  case Node::ExpressionStatement:
+    return compile(static_cast<ExpressionStatement *>(statement)->expression);
+
+  case Node::Block:
+    return compile_branch(static_cast<Block *>(statement));
+
+  case Node::LetStatement:
+  case Node::AssignStatement: {
+    auto *name = statement->type() == Node::LetStatement
+                     ? static_cast<LetStatement *>(statement)->name
+                     : static_cast<AssignStatement *>(statement)->name;
+    auto *value = statement->type() == Node::LetStatement
+                      ? static_cast<LetStatement *>(statement)->value
+                      : static_cast<AssignStatement *>(statement)->value;
+    const auto type = compile(value);
+    if (type == NativeType::NONE) {
+      return type;
+    }
+    if (!readable(type) || name->slot >= slot_types.size()) {
+      reject();
+      return type;
+    }
+    auto &slot_type = slot_types.at(name->slot);
+    if (slot_type != NativeType::NONE && slot_type != type) {
+      reject();
+    }
+    slot_type = type;
+    store(name->slot);
+    assigned.at(name->slot) = true;
+    return type;
+  }
+
+  case Node::ReturnStatement:
+    return compile_return(static_cast<ReturnStatement *>(statement));
+
+  case Node::Loop:
+    return compile_loop(static_cast<LoopStatement *>(statement));
+
+  default:
+    reject();
+    return NativeType::MIXED;
+  }
+}
+
+auto NativeCompiler::compile_return(ReturnStatement *return_statement)
+    -> NativeType
+{
+  if (return_statement->tail_call) {
+    // the call takes the place of this one: new arguments, same frame
+    auto *call = static_cast<Call *>(return_statement->return_value);
+    if (!self_call(call)) {
+      reject();
+      return NativeType::NONE;
+    }
+    if (push_arguments(call) == NativeType::NONE) {
+      return NativeType::NONE;
+    }
+    const auto &parameters = function->parameters;
+    for (auto i = parameters.size(); i > 0; i--) {
+      pop_rax();
+      store(parameters.at(i - 1)->slot);
+    }
+    drop_temps(0);
+    jump(start);
+    return NativeType::NONE;
+  }
+
+  const auto type = compile(return_statement->return_value);
+  if (type == NativeType::NONE) {
+    return type;
+  }
+  // inside a mientras it only ends the iteration
+  if (!loops.empty()) {
+    drop_temps(loops.back().temps);
+    jump(loops.back().head);
+    return NativeType::NONE;
+  }
+  if (!readable(type)) {
+    reject();
+  }
+  jit.result = join(jit.result, type);
+  jump(exit);
+  return NativeType::NONE;
+}
+
+auto NativeCompiler::compile_loop(LoopStatement *loop) -> NativeType
+{
+  const auto head = code.new_label();
+  const auto end = code.new_label();
+
+  code.bind(head);
+  const auto condition = compile(loop->condition);
+  if (condition == NativeType::BOOL) {
+    jump_if_rax_zero(end);
+  }
+  else if (condition == NativeType::NIL) {
+    jump(end);
+  }
+  // any integer is truthy, so an INT condition never ends the loop
+  else if (condition != NativeType::INT) {
+    reject();
+    return NativeType::NIL;
+  }
+
+  loops.push_back({head, temps});
+  compile_branch(loop->repeat);
+  loops.pop_back();
+  jump(head);
+
+  code.bind(end);
+  set_rax(0);
+  return NativeType::NIL;
+}
+
+auto NativeCompiler::compile(Expression *expression) -> NativeType
+{
+  switch (expression->type()) {
+
+  case Node::Integer:
+    set_rax(static_cast<std::int64_t>(
+        static_cast<Integer *>(expression)->value));
+    return NativeType::INT;
+
+  case Node::Boolean:
+    set_rax(static_cast<Boolean *>(expression)->value ? 1 : 0);
+    return NativeType::BOOL;
+
+  case Node::Null:
+    set_rax(0);
+    return NativeType::NIL;
+
+  case Node::Identifier: {
+    auto *name = static_cast<Identifier *>(expression);
+    // a slot read before it's assigned falls back to outer scopes
+    if (name->depth != 0 || name->slot >= slot_types.size() ||
+        !assigned.at(name->slot)) {
+      reject();
+      return NativeType::MIXED;
+    }
+    load(name->slot);
+    return slot_types.at(name->slot);
+  }
+
+  case Node::Prefix:
+    return compile_prefix(static_cast<Prefix *>(expression));
+
+  case Node::Infix:
+    return compile_infix(static_cast<Infix *>(expression));
+
+  case Node::If:
+    return compile_if(static_cast<If *>(expression));
+
+  case Node::Call: {
+    auto *call = static_cast<Call *>(expression);
+    if (!self_call(call)) {
+      reject();
+      return NativeType::MIXED;
+    }
+    const auto type = push_arguments(call);
+    if (type == NativeType::NONE) {
+      return type;
+    }
+    code.emit({0xE8}); // call body, which pops the arguments
+    code.rel32(body);
+    temps -= call->arguments.size();
+    calls_itself = true;
+    return NativeType::INT;
+  }
+
+  default:
+    reject();
+    return NativeType::MIXED;
+  }
+}
+
+auto NativeCompiler::compile_prefix(Prefix *prefix) -> NativeType
+{
+  const auto type = compile(prefix->right);
+  if (type == NativeType::NONE) {
+    return type;
+  }
+  if (prefix->op == Operator::MINUS && type == NativeType::INT) {
+    code.emit({0x48, 0xF7, 0xD8}); // neg rax
+    return NativeType::INT;
+  }
+  if (prefix->op != Operator::NEGATION) {
+    reject();
+    return NativeType::MIXED;
+  }
+  switch (type) {
+  case NativeType::BOOL:
+    code.emit({0x48, 0x83, 0xF0, 0x01}); // xor rax, 1
+    return NativeType::BOOL;
+  case NativeType::INT:
+    set_rax(0);
+    return NativeType::BOOL;
+  case NativeType::NIL:
+    set_rax(1);
+    return NativeType::BOOL;
+  default:
+    reject();
+    return NativeType::MIXED;
+  }
+}
+
+auto NativeCompiler::compile_infix(Infix *infix) -> NativeType
+{
+  const auto left = compile(infix->left);
+  if (left == NativeType::NONE) {
+    return left;
+  }
+  push_rax();
+  const auto right = compile(infix->right);
+  if (right == NativeType::NONE) {
+    temps--;
+    return right;
+  }
+  code.emit({0x48, 0x89, 0xC1}); // mov rcx, rax
+  pop_rax();
+  if (!readable(left) || !readable(right)) {
+    reject();
+    return NativeType::MIXED;
+  }
+
+  const auto op = infix->op;
+  if (left == NativeType::INT && right == NativeType::INT) {
+    return compile_integer_infix(op);
+  }
+  if (op != Operator::EQ && op != Operator::NOT_EQ) {
+    // an error, which native code leaves to the evaluator
+    reject();
+    return NativeType::MIXED;
+  }
+  if (left != right) {
+    set_rax(op == Operator::NOT_EQ ? 1 : 0);
+  }
+  else if (left == NativeType::NIL) {
+    set_rax(op == Operator::EQ ? 1 : 0);
+  }
+  else {
+    const std::uint8_t condition = op == Operator::EQ ? 0x94 : 0x95;
+    code.emit({0x48, 0x39, 0xC8});      // cmp rax, rcx
+    code.emit({0x0F, condition, 0xC0}); // sete or setne al
+    code.emit({0x0F, 0xB6, 0xC0});      // movzx eax, al
+  }
+  return NativeType::BOOL;
+}
+
+auto NativeCompiler::compile_integer_infix(Operator op) -> NativeType
+{
+  std::uint8_t condition = 0;
+  switch (op) {
+  case Operator::PLUS:
+    code.emit({0x48, 0x01, 0xC8}); // add rax, rcx
+    return NativeType::INT;
+  case Operator::MINUS:
+    code.emit({0x48, 0x29, 0xC8}); // sub rax, rcx
+    return NativeType::INT;
+  case Operator::MULTIPLICATION:
+    code.emit({0x48, 0x0F, 0xAF, 0xC1}); // imul rax, rcx
+    return NativeType::INT;
+  case Operator::DIVISION: {
+    const auto divide = code.new_label();
+    const auto done = code.new_label();
+    code.emit({0x48, 0x85, 0xC9, 0x0F, 0x84}); // test rcx, rcx; jz bail
+    code.rel32(bail);
+    code.emit({0x48, 0x83, 0xF9, 0xFF, 0x0F, 0x85}); // cmp rcx, -1; jne
+    code.rel32(divide);
+    // dividing by -1 wraps like negating, where idiv would fault
+    code.emit({0x48, 0xF7, 0xD8}); // neg rax
+    jump(done);
+    code.bind(divide);
+    code.emit({0x48, 0x99, 0x48, 0xF7, 0xF9}); // cqo; idiv rcx
+    code.bind(done);
+    return NativeType::INT;
+  }
+  case Operator::LT:
+    condition = 0x9C; // setl
+    break;
+  case Operator::GT:
+    condition = 0x9F; // setg
+    break;
+  case Operator::EQ:
+    condition = 0x94; // sete
+    break;
+  case Operator::NOT_EQ:
+    condition = 0x95; // setne
+    break;
+  default:
+    reject();
+    return NativeType::MIXED;
+  }
+  code.emit({0x48, 0x39, 0xC8});      // cmp rax, rcx
+  code.emit({0x0F, condition, 0xC0}); // setcc al
+  code.emit({0x0F, 0xB6, 0xC0});      // movzx eax, al
+  return NativeType::BOOL;
+}
+
+auto NativeCompiler::compile_if(If *if_expression) -> NativeType
+{
+  const auto otherwise = code.new_label();
+  const auto done = code.new_label();
+
+  const auto condition = compile(if_expression->condition);
+  if (condition == NativeType::NONE) {
+    return condition;
+  }
+  if (condition == NativeType::BOOL) {
+    jump_if_rax_zero(otherwise);
+  }
+  else if (condition == NativeType::NIL) {
+    jump(otherwise);
+  }
+  else if (condition != NativeType::INT) {
+    reject();
+    return NativeType::MIXED;
+  }
+
+  auto type = compile_branch(if_expression->consequence);
+  jump(done);
+  code.bind(otherwise);
+  if (if_expression->alternative != nullptr) {
+    type = join(type, compile_branch(if_expression->alternative));
+  }
+  else {
+    set_rax(0);
+    type = join(type, NativeType::NIL);
+  }
+  code.bind(done);
+  return type;
+}
+
+// maps the code where it can run, false when the system won't let it
+static auto install(const std::vector<std::uint8_t> &bytes, JitFunction &jit)
+    -> bool
+{
+  const auto page = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+  const auto size = (bytes.size() + page - 1) / page * page;
+  void *memory = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (memory == MAP_FAILED) {
+    return false;
+  }
+  std::memcpy(memory, bytes.data(), bytes.size());
+  if (mprotect(memory, size, PROT_READ | PROT_EXEC) != 0) {
+    munmap(memory, size);
+    return false;
+  }
+  jit.code = memory;
+  jit.code_size = size;
+  return true;
+}
+
+static void compile_function(obj::Function *fun, JitFunction &jit)
+{
+  NativeCompiler compiler(fun, jit);
+  const auto bytes = compiler.compile();
+  jit.state = !bytes.empty() && install(bytes, jit)
+                  ? JitFunction::State::COMPILED
+                  : JitFunction::State::REJECTED;
+}
+
+auto call_native(obj::Function *fun, const std::vector<obj::Value> &args,
+                 std::size_t depth_budget, std::size_t stack_room)
+    -> std::optional<obj::Value>
+{
+  if (jit_threshold == 0) {
+    return std::nullopt;
+  }
+  auto &native = fun->body->native;
+  if (native == nullptr) {
+    native = std::make_shared<JitFunction>();
+  }
+  auto &jit = *native;
+  if (jit.state == JitFunction::State::REJECTED) {
+    return std::nullopt;
+  }
+  if (jit.state == JitFunction::State::COUNTING) {
+    if (++jit.calls < jit_threshold) {
+      return std::nullopt;
+    }
+    compile_function(fun, jit);
+    if (jit.state != JitFunction::State::COMPILED) {
+      return std::nullopt;
+    }
+  }
+
+  std::array<std::int64_t, MAX_NATIVE_PARAMETERS> arguments{};
+  for (std::size_t i = 0; i < args.size(); i++) {
+    if (!args[i].is_integer()) {
+      return std::nullopt;
+    }
+    arguments.at(i) = args[i].as_integer();
+  }
+  for (const auto &[depth, slot] : jit.self_references) {
+    const auto value = fun->env->ancestor(depth)->get_slot(slot);
+    if (!value.is_object() || value.as_object() != fun) {
+      return std::nullopt;
+    }
+  }
+
+  const auto here =
+      reinterpret_cast<std::uintptr_t>(__builtin_frame_address(0));
+  NativeContext context{
+      0, static_cast<std::int64_t>(std::min(depth_budget, MAX_NATIVE_DEPTH)),
+      0,
+      static_cast<std::int64_t>(here > stack_room ? here - stack_room : 0)};
+  auto *entry = reinterpret_cast<NativeEntry>(jit.code);
+  const auto result = entry(arguments.data(), &context);
+  if (context.bailed != 0) {
+    if (++jit.bails >= MAX_BAILS) {
+      jit.state = JitFunction::State::REJECTED;
+    }
+    return std::nullopt;
+  }
+
+  switch (jit.result) {
+  case NativeType::INT:
+    return obj::Value::make_integer(result);
+  case NativeType::BOOL:
+    return obj::Value::make_boolean(result != 0);
+  default:
+    return obj::Value();
+  }
+}
+
+#else
+
+auto call_native(obj::Function * /*unused*/,
+                 const std::vector<obj::Value> & /*unused*/,
+                 std::size_t /*unused*/, std::size_t /*unused*/)
+    -> std::optional<obj::Value>
+{
+  return std::nullopt;
+}
+
+#endif
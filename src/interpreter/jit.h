@@ -0,0 +1,35 @@
+#ifndef JIT_H
+#define JIT_H
+#include "object.h"
+#include <cstddef>
+#include <optional>
+#include <vector>
+
+#if defined(__x86_64__) && defined(__linux__)
+#define MIMIR_HAS_JIT
+#endif
+
+inline constexpr std::size_t DEFAULT_JIT_THRESHOLD = 100;
+
+// What the JIT knows about the procedimientos with one body: how often they
+// were called and, once they got hot, their native code or why they have
+// none. Defined in jit.cpp.
+class JitFunction;
+
+// The result of calling fun with args as x86-64 code, for procedimientos that
+// only compute with integers and booleans and only call themselves. Nothing
+// when the call has to be evaluated instead: fun isn't hot yet or can't be
+// compiled, an argument isn't an integer, fun no longer finds itself under
+// the name it calls itself by, or the native code met something it doesn't
+// handle, like a division by zero. Native code has no side effects, so
+// giving up halfway and evaluating the call from the start is always safe.
+// depth_budget is how many nested calls the evaluator would still allow and
+// stack_room how many bytes of native stack it can still give them.
+auto call_native(obj::Function *fun, const std::vector<obj::Value> &args,
+                 std::size_t depth_budget, std::size_t stack_room)
+    -> std::optional<obj::Value>;
+// calls before a procedimiento is compiled, 0 turns the JIT off
+void set_jit_threshold(std::size_t calls);
+[[nodiscard]] auto has_native_code(const obj::Function *fun) -> bool;
+
+#endif // JIT_H
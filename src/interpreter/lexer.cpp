@@ -1,31 +1,190 @@
 #include "lexer.h"
+#include "source.h"
 #include "token.h"
 #include "utils.h"
+#include <algorithm>
 #include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
 #include <iostream>
+#include <memory>
 #include <string>
 #include <string_view>
 #include <utility>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define MIMIR_LEXER_SSE2
+static constexpr std::size_t SSE2_WIDTH = 16;
+#endif
+
 using namespace std;
 
-auto is_indentation(char) -> bool;
-auto is_number(char /*chr*/) -> bool;
-auto is_identifier(char /*chr*/) -> bool;
-auto skip_whitespace(char /*chr*/, int & /*line*/) -> bool;
+enum CharacterClass : std::uint8_t {
+  WHITESPACE = 1U << 0U,
+  DIGIT = 1U << 1U,
+  LETTER = 1U << 2U,
+  IDENTIFIER = 1U << 3U,
+};
+
+// Bytes from 0x80 up belong to UTF-8 sequences and are taken as letters, so
+// identifiers like año work without decoding anything.
+static constexpr auto CHARACTER_CLASSES = [] {
+  array<std::uint8_t, 256> classes{};
+  for (std::size_t chr = 0; chr < classes.size(); chr++) {
+    const bool letter = (chr >= 'a' && chr <= 'z') ||
+                        (chr >= 'A' && chr <= 'Z') || chr >= 0x80;
+    const bool digit = chr >= '0' && chr <= '9';
+    if (letter) {
+      classes[chr] |= LETTER | IDENTIFIER;
+    }
+    if (digit) {
+      classes[chr] |= DIGIT | IDENTIFIER;
+    }
+  }
+  classes['_'] |= IDENTIFIER;
+  for (const auto chr : {' ', '\t', '\r', '\n'}) {
+    classes[static_cast<unsigned char>(chr)] |= WHITESPACE;
+  }
+  return classes;
+}();
+
+inline auto has_class(char chr, CharacterClass cls) -> bool
+{
+  return (CHARACTER_CLASSES[static_cast<unsigned char>(chr)] & cls) != 0;
+}
+
+#ifdef MIMIR_LEXER_SSE2
+inline auto in_range(__m128i chunk, char low, char high) -> __m128i
+{
+  return _mm_and_si128(
+      _mm_cmpgt_epi8(chunk, _mm_set1_epi8(static_cast<char>(low - 1))),
+      _mm_cmplt_epi8(chunk, _mm_set1_epi8(static_cast<char>(high + 1))));
+}
+
+inline auto byte_mask(__m128i matches) -> unsigned
+{
+  return static_cast<unsigned>(_mm_movemask_epi8(matches));
+}
+
+inline auto identifier_mask(__m128i chunk) -> unsigned
+{
+  // or-ing 0x20 folds upper case into lower case without letting any other
+  // ASCII byte into a..z; UTF-8 bytes show up in the sign bits
+  const auto folded = _mm_or_si128(chunk, _mm_set1_epi8(0x20));
+  const auto matches = _mm_or_si128(
+      _mm_or_si128(in_range(folded, 'a', 'z'), in_range(chunk, '0', '9')),
+      _mm_cmpeq_epi8(chunk, _mm_set1_epi8('_')));
+  return byte_mask(matches) | byte_mask(chunk);
+}
+
+inline auto digit_mask(__m128i chunk) -> unsigned
+{
+  return byte_mask(in_range(chunk, '0', '9'));
+}
+
+inline auto whitespace_mask(__m128i chunk) -> unsigned
+{
+  const auto is = [chunk](char chr) {
+    return _mm_cmpeq_epi8(chunk, _mm_set1_epi8(chr));
+  };
+  return byte_mask(
+      _mm_or_si128(_mm_or_si128(is(' '), is('\t')),
+                   _mm_or_si128(is('\r'), is('\n'))));
+}
+#endif
+
+#ifdef MIMIR_LEXER_SSE2
+// Walks a run that outlasted the first chunk sixteen bytes at a time; mask
+// has a bit set for every byte of the chunk that continues the run.
+template <typename Mask>
+auto scan_long_run(string_view source, std::size_t index, Mask mask)
+    -> std::size_t
+{
+  for (; index + SSE2_WIDTH <= source.size(); index += SSE2_WIDTH) {
+    const auto chunk = _mm_loadu_si128(
+        reinterpret_cast<const __m128i *>(source.data() + index));
+    const auto run = std::countr_one(mask(chunk));
+    if (run < static_cast<int>(SSE2_WIDTH)) {
+      return index + static_cast<std::size_t>(run);
+    }
+  }
+  return index;
+}
+#endif
+
+// Index of the first byte from begin outside of cls. Most tokens are a few
+// bytes long, so runs are walked through the table and the vector loop only
+// takes over once a run outlasts one chunk.
+template <typename Mask>
+auto scan_run(string_view source, std::size_t begin, CharacterClass cls,
+              [[maybe_unused]] Mask mask) -> std::size_t
+{
+  auto index = begin;
+#ifdef MIMIR_LEXER_SSE2
+  const auto first_chunk = std::min(source.size(), begin + SSE2_WIDTH);
+  while (index < first_chunk && has_class(source[index], cls)) {
+    index++;
+  }
+  if (index == begin + SSE2_WIDTH) {
+    index = scan_long_run(source, index, mask);
+  }
+#endif
+  while (index < source.size() && has_class(source[index], cls)) {
+    index++;
+  }
+  return index;
+}
+
+auto scan_identifier(string_view source, std::size_t begin) -> std::size_t
+{
+#ifdef MIMIR_LEXER_SSE2
+  return scan_run(source, begin, IDENTIFIER, identifier_mask);
+#else
+  return scan_run(source, begin, IDENTIFIER, nullptr);
+#endif
+}
 
-Lexer::Lexer(const string &src)
-    : source(src), current_char(' '), read_position(0), position(0), line(1)
+auto scan_number(string_view source, std::size_t begin) -> std::size_t
+{
+#ifdef MIMIR_LEXER_SSE2
+  return scan_run(source, begin, DIGIT, digit_mask);
+#else
+  return scan_run(source, begin, DIGIT, nullptr);
+#endif
+}
+
+// Skips whitespace from begin, counting the lines on the way.
+auto scan_whitespace(string_view source, std::size_t begin, int &line)
+    -> std::size_t
+{
+#ifdef MIMIR_LEXER_SSE2
+  const auto index = scan_run(source, begin, WHITESPACE, whitespace_mask);
+#else
+  const auto index = scan_run(source, begin, WHITESPACE, nullptr);
+#endif
+  line += static_cast<int>(
+      std::count(source.begin() + static_cast<std::ptrdiff_t>(begin),
+                 source.begin() + static_cast<std::ptrdiff_t>(index), '\n'));
+  return index;
+}
+
+Lexer::Lexer(const string &src) : Lexer(SourceBuffer::copy(src)) {}
+
+Lexer::Lexer(shared_ptr<const SourceBuffer> src)
+    : buffer(std::move(src)), source(buffer->view()), current_char(' '),
+      read_position(0), position(0), line(1)
 {
 }
 
 void Lexer::read_character()
-// TODO switch to char pointers instead of ints
 {
   if (read_position >= source.size()) {
     current_char = '\0';
   }
   else {
-    current_char = source.at(read_position);
+    current_char = source[read_position];
   }
 
   position = read_position;
@@ -34,179 +193,99 @@ void Lexer::read_character()
 
 auto Lexer::next_token() -> Token
 {
+  read_position = scan_whitespace(source, read_position, line);
   read_character();
-  while (skip_whitespace(current_char, line)) {
-    read_character();
-  }
 
-  switch (current_char) {
-  case 'a':
-  case 'b':
-  case 'c':
-  case 'd':
-  case 'e':
-  case 'f':
-  case 'g':
-  case 'h':
-  case 'i':
-  case 'j':
-  case 'k':
-  case 'l':
-  case 'm':
-  case 'n':
-  case 'o':
-  case 'p':
-  case 'q':
-  case 'r':
-  case 's':
-  case 't':
-  case 'u':
-  case 'v':
-  case 'w':
-  case 'x':
-  case 'y':
-  case 'z':
-  case 'A':
-  case 'B':
-  case 'C':
-  case 'D':
-  case 'E':
-  case 'F':
-  case 'G':
-  case 'H':
-  case 'I':
-  case 'J':
-  case 'K':
-  case 'L':
-  case 'M':
-  case 'N':
-  case 'O':
-  case 'P':
-  case 'Q':
-  case 'R':
-  case 'S':
-  case 'T':
-  case 'U':
-  case 'V':
-  case 'W':
-  case 'X':
-  case 'Y':
-  case 'Z':
+  if (has_class(current_char, LETTER)) {
     return read_identifier();
-  case '0':
-  case '1':
-  case '2':
-  case '3':
-  case '4':
-  case '5':
-  case '6':
-  case '7':
-  case '8':
-  case '9':
+  }
+  if (has_class(current_char, DIGIT)) {
     return read_number();
+  }
+
+  switch (current_char) {
   case '=':
     if (peek_character() == '=') {
       read_position++;
       return {TokenType::EQ, "==", line, 2};
     }
-    return {TokenType::ASSIGN, &current_char, line};
+    return single_character(TokenType::ASSIGN);
   case '+':
-    return {TokenType::PLUS, &current_char, line};
+    return single_character(TokenType::PLUS);
   case '-':
-    return {TokenType::MINUS, &current_char, line};
+    return single_character(TokenType::MINUS);
   case '/':
-    return {TokenType::DIVISION, &current_char, line};
+    return single_character(TokenType::DIVISION);
   case '*':
-    return {TokenType::MULTIPLICATION, &current_char, line};
+    return single_character(TokenType::MULTIPLICATION);
   case '!':
     if (peek_character() == '=') {
       read_position++;
       return {TokenType::NOT_EQ, "!=", line, 2};
     }
-    return {TokenType::NEGATION, &current_char, line};
+    return single_character(TokenType::NEGATION);
   case '<':
-    return {TokenType::LT, &current_char, line};
+    return single_character(TokenType::LT);
   case '>':
-    return {TokenType::GT, &current_char, line};
+    return single_character(TokenType::GT);
   case '(':
-    return {TokenType::LPAREN, &current_char, line};
+    return single_character(TokenType::LPAREN);
   case ')':
-    return {TokenType::RPAREN, &current_char, line};
+    return single_character(TokenType::RPAREN);
   case '{':
-    return {TokenType::LBRACE, &current_char, line};
+    return single_character(TokenType::LBRACE);
   case '}':
-    return {TokenType::RBRACE, &current_char, line};
+    return single_character(TokenType::RBRACE);
   case ',':
-    return {TokenType::COMMA, &current_char, line};
+    return single_character(TokenType::COMMA);
   case ';':
-    return {TokenType::SEMICOLON, &current_char, line};
+    return single_character(TokenType::SEMICOLON);
   case '\"':
     return read_string('\"');
   case '\'':
     return read_string('\'');
   case '\0':
-    return {TokenType::_EOF, &current_char, line};
+    return {TokenType::_EOF, "\0", line};
   default:
-    return {TokenType::ILLEGAL, &current_char, line};
+    return single_character(TokenType::ILLEGAL);
   }
 }
 
 auto Lexer::read_identifier() -> Token
 {
-  const char *begin = &source.at(position);
-  const char *end;
-  while (is_identifier(current_char)) {
-    read_character();
-  }
-  if (current_char == '\0') {
-    end = &source.at(position - 1);
-    end++;
-  }
-  else {
-    end = &source.at(position);
-  }
-  read_position = position;
+  const auto begin = position;
+  read_position = scan_identifier(source, read_position);
 
-  return keyword(string(begin, end));
+  return keyword(source.substr(begin, read_position - begin));
 }
 
 auto Lexer::read_number() -> Token
 {
-  const char *begin = &source.at(position);
-  const char *end;
-  while (is_number(current_char)) {
-    read_character();
-  }
-  if (current_char == '\0') {
-    end = &source.at(position - 1);
-    end++;
-  }
-  else {
-    end = &source.at(position);
-  }
-  read_position = position;
+  const auto begin = position;
+  read_position = scan_number(source, read_position);
 
-  return Token{TokenType::INT, begin, end, line};
+  return Token{TokenType::INT, source.substr(begin, read_position - begin),
+               line};
 }
 
 auto Lexer::read_string(char quote) -> Token
 {
   read_character();
   if (current_char == quote) {
-    return Token{TokenType::STRING, string(""), line};
+    return Token{TokenType::STRING, string_view(), line};
   }
 
-  const char *begin = &source.at(position);
-  const char *end = begin;
+  const auto begin = position;
+  auto end = begin;
   while (current_char != '\0') {
     read_character();
     if (current_char == quote) {
-      end = &source.at(position);
+      end = position;
       break;
     }
   }
 
-  return Token{TokenType::STRING, begin, end, line};
+  return Token{TokenType::STRING, source.substr(begin, end - begin), line};
 }
 
 static constexpr array<pair<string_view, TokenType>, 9> keyword_values{{
@@ -218,127 +297,28 @@ static constexpr array<pair<string_view, TokenType>, 9> keyword_values{{
     {"si_no", TokenType::ELSE},
     {"verdadero", TokenType::_TRUE},
     {"falso", TokenType::_FALSE},
+    {"nulo", TokenType::_NULL},
 }};
 
-auto Lexer::keyword(const string &str) const -> Token
+auto Lexer::keyword(string_view str) const -> Token
 {
   static constexpr auto keywords =
-      Map<string_view, TokenType, keyword_values.size()>{{keyword_values}};
+      PerfectMap<string_view, TokenType, keyword_values.size()>{
+          keyword_values};
 
-  if (keywords.find(str)) {
-    return {keywords.at(str), str, line};
+  if (const auto *type = keywords.find(str)) {
+    return {*type, str, line};
   }
 
   return {TokenType::IDENT, str, line};
 }
 
-auto Lexer::peek_character() const -> char
+auto Lexer::single_character(TokenType type) const -> Token
 {
-  return read_position >= source.size() ? '\0' : source.at(read_position);
+  return {type, source.substr(position, 1), line};
 }
 
-auto is_identifier(char chr) -> bool
-{
-  switch (chr) {
-  case 'a':
-  case 'b':
-  case 'c':
-  case 'd':
-  case 'e':
-  case 'f':
-  case 'g':
-  case 'h':
-  case 'i':
-  case 'j':
-  case 'k':
-  case 'l':
-  case 'm':
-  case 'n':
-  case 'o':
-  case 'p':
-  case 'q':
-  case 'r':
-  case 's':
-  case 't':
-  case 'u':
-  case 'v':
-  case 'w':
-  case 'x':
-  case 'y':
-  case 'z':
-  case 'A':
-  case 'B':
-  case 'C':
-  case 'D':
-  case 'E':
-  case 'F':
-  case 'G':
-  case 'H':
-  case 'I':
-  case 'J':
-  case 'K':
-  case 'L':
-  case 'M':
-  case 'N':
-  case 'O':
-  case 'P':
-  case 'Q':
-  case 'R':
-  case 'S':
-  case 'T':
-  case 'U':
-  case 'V':
-  case 'W':
-  case 'X':
-  case 'Y':
-  case 'Z':
-  case '0':
-  case '1':
-  case '2':
-  case '3':
-  case '4':
-  case '5':
-  case '6':
-  case '7':
-  case '8':
-  case '9':
-  case '_':
-    return true;
-  default:
-    return false;
-  }
-}
-
-auto is_number(char chr) -> bool
-{
-  switch (chr) {
-  case '0':
-  case '1':
-  case '2':
-  case '3':
-  case '4':
-  case '5':
-  case '6':
-  case '7':
-  case '8':
-  case '9':
-    return true;
-  default:
-    return false;
-  }
-}
-
-auto skip_whitespace(char chr, int &line) -> bool
+auto Lexer::peek_character() const -> char
 {
-  switch (chr) {
-  case '\n':
-    line++;
-    [[fallthrough]];
-  case '\r':
-  case ' ':
-  case '\t':
-    return true;
-  default:
-    return false;
-  }
+  return read_position >= source.size() ? '\0' : source[read_position];
 }
@@ -1,27 +1,39 @@
 #ifndef LEXER_H
 #define LEXER_H
+#include "source.h"
 #include "token.h"
 #include <cstddef>
+#include <memory>
 #include <string>
+#include <string_view>
 
 class Lexer {
 private:
-  const std::string source;
+  std::shared_ptr<const SourceBuffer> buffer;
+  std::string_view source;
   char current_char;
   std::size_t read_position;
   std::size_t position;
   int line;
 
   void read_character();
-  [[nodiscard]] auto keyword(const std::string &) const -> Token;
+  [[nodiscard]] auto keyword(std::string_view) const -> Token;
+  [[nodiscard]] auto single_character(TokenType) const -> Token;
   auto read_string(char) -> Token;
   auto read_identifier() -> Token;
   auto read_number() -> Token;
   [[nodiscard]] auto peek_character() const -> char;
 
 public:
+  // copies the code into a buffer of its own
   explicit Lexer(const std::string &);
+  explicit Lexer(std::shared_ptr<const SourceBuffer>);
   auto next_token() -> Token;
+  [[nodiscard]] auto source_buffer() const
+      -> const std::shared_ptr<const SourceBuffer> &
+  {
+    return buffer;
+  }
 };
 
 #endif // LEXER_H
@@ -1,105 +1,78 @@
 #include "object.h"
+#include <cassert>
 
-auto obj::Integer::type_string() const -> std::string_view
+auto obj::Object::type_string() const -> std::string_view
 {
-  return getNameForValue(objects_enums_string, ObjectType::INTEGER);
+  return getNameForValue(objects_enums_string, object_type);
 }
 
-auto obj::Integer::inspect() const -> std::string
+auto obj::Value::inspect() const -> std::string
 {
-  return std::to_string(value);
-}
-
-auto obj::Integer::type() const -> ObjectType { return ObjectType::INTEGER; }
-
-auto obj::Boolean::type() const -> ObjectType { return ObjectType::BOOLEAN; }
-
-auto obj::Boolean::inspect() const -> std::string
-{
-  return value ? "verdadero" : "falso";
-}
-
-auto obj::Boolean::type_string() const -> std::string_view
-{
-  return getNameForValue(objects_enums_string, ObjectType::BOOLEAN);
-}
-
-auto obj::Null::type() const -> ObjectType { return ObjectType::_NULL; }
-
-auto obj::Null::inspect() const -> std::string { return "nulo"; }
-
-auto obj::Null::type_string() const -> std::string_view
-{
-  return getNameForValue(objects_enums_string, ObjectType::_NULL);
+  switch (tag) {
+  case Tag::BOOLEAN:
+    return as.boolean ? "verdadero" : "falso";
+  case Tag::INTEGER:
+    return std::to_string(as.integer);
+  case Tag::OBJECT:
+    return as.object->inspect();
+  default:
+    return "nulo";
+  }
 }
 
-auto obj::Return::type() const -> ObjectType { return ObjectType::RETURN; }
-
-auto obj::Return::inspect() const -> std::string { return value->inspect(); }
-
-auto obj::Return::type_string() const -> std::string_view
+auto obj::Value::type_string() const -> std::string_view
 {
-  return getNameForValue(objects_enums_string, ObjectType::RETURN);
+  return getNameForValue(objects_enums_string, type());
 }
 
-auto obj::Error::type() const -> ObjectType { return ObjectType::ERROR; }
-
 auto obj::Error::inspect() const -> std::string { return message; }
 
-auto obj::Error::type_string() const -> std::string_view
+auto obj::Environment::lookup(Symbol name) const -> Value
 {
-  return getNameForValue(objects_enums_string, ObjectType::ERROR);
+  for (const auto *env = this; env != nullptr; env = env->outer) {
+    auto value = env->get_slot(env->scope->find(name));
+    if (!value.is_unset()) {
+      return value;
+    }
+  }
+  return Value::make_unset();
 }
 
-void obj::Environment::set_item(const std::string &key, Object *value)
+auto obj::Environment::globals() -> ast::Scope &
 {
-  store[key] = value;
+  assert(globals_scope != nullptr);
+  return *globals_scope;
 }
 
-void obj::Environment::del_item(const std::string &key) { store.erase(key); }
+auto obj::Function::inspect() const -> std::string { return "Función"; }
 
-auto obj::Environment::get_item(const std::string &key) -> Object *
+obj::String::String(const String &prefix, std::string_view tail)
+    : Object(ObjectType::STRING), buffer(prefix.buffer),
+      length(prefix.length + tail.size()), grown(0)
 {
-  if (store[key] != nullptr) {
-    return store[key];
+  const auto *data = buffer->data();
+  const bool aliased =
+      tail.data() >= data && tail.data() < data + buffer->size();
+  auto capacity = buffer->capacity();
+  if (!prefix.extendable || prefix.length != buffer->size()) {
+    // the buffer is sealed, or another string already extends it past the
+    // prefix
+    buffer = std::make_shared<std::string>(prefix.value());
+    capacity = 0;
   }
-  return outer->get_item(key);
-}
-
-auto obj::Environment::item_exist(const std::string &key) -> bool
-{
-  if (store.find(key) != store.end()) {
-    return true;
+  if (aliased) {
+    buffer->append(std::string(tail));
   }
-  if ((outer != nullptr) && outer->item_exist(key)) {
-    return true;
+  else {
+    buffer->append(tail);
   }
-  return false;
-}
-
-auto obj::Function::type() const -> ObjectType { return ObjectType::FUNCTION; }
-
-auto obj::Function::type_string() const -> std::string_view
-{
-  return getNameForValue(objects_enums_string, ObjectType::FUNCTION);
+  grown = buffer->capacity() - capacity;
 }
 
-auto obj::Function::inspect() const -> std::string { return "Función"; }
-
-auto obj::String::type() const -> ObjectType { return ObjectType::STRING; }
-
-auto obj::String::inspect() const -> std::string { return value; }
-
-auto obj::String::type_string() const -> std::string_view
+auto obj::String::inspect() const -> std::string
 {
-  return getNameForValue(objects_enums_string, ObjectType::STRING);
+  return std::string(value());
 }
 
-auto obj::Builtin::type() const -> ObjectType { return ObjectType::BUILTIN; }
-
 auto obj::Builtin::inspect() const -> std::string { return "builtin function"; }
 
-auto obj::Builtin::type_string() const -> std::string_view
-{
-  return getNameForValue(objects_enums_string, ObjectType::BUILTIN);
-}
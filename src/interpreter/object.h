@@ -4,137 +4,295 @@
 #include "parser.h"
 #include "token.h"
 #include "utils.h"
+#include <algorithm>
 #include <cstddef>
+#include <cstdint>
 #include <functional>
-#include <map>
+#include <limits>
+#include <memory>
 #include <string>
 #include <string_view>
+#include <utility>
 #include <vector>
 
+class FunctionProto;
+
 namespace obj {
-enum class ObjectType {
+enum class ObjectType : std::uint8_t {
   BOOLEAN,
   INTEGER,
   /*NOLINT*/ _NULL,
-  RETURN,
   ERROR,
   FUNCTION,
   STRING,
   BUILTIN
 };
 
-static constexpr std::array<const NameValuePair<ObjectType>, 8>
+static constexpr std::array<const NameValuePair<ObjectType>, 7>
     objects_enums_string{{{ObjectType::BOOLEAN, "BOOLEAN"},
                           {ObjectType::INTEGER, "INTEGER"},
                           {ObjectType::_NULL, "NULL"},
-                          {ObjectType::RETURN, "RETURN"},
                           {ObjectType::ERROR, "ERROR"},
                           {ObjectType::FUNCTION, "FUNCTION"},
                           {ObjectType::STRING, "STRING"},
                           {ObjectType::BUILTIN, "BUILTIN"}}};
 
+// Each subclass passes its type once, so type tests read a field instead of
+// making a virtual call; only inspect() still dispatches.
 class Object {
+  const ObjectType object_type;
+
+protected:
+  explicit Object(ObjectType type) : object_type(type) {}
+
 public:
-  [[nodiscard]] virtual auto type() const -> ObjectType = 0;
+  std::uint32_t mark = 0;
+  [[nodiscard]] auto type() const -> ObjectType { return object_type; }
   [[nodiscard]] virtual auto inspect() const -> std::string = 0;
-  [[nodiscard]] virtual auto type_string() const -> std::string_view = 0;
+  [[nodiscard]] auto type_string() const -> std::string_view;
   virtual ~Object() = default;
-  Object() = default;
   Object(const Object &) = delete;
   auto operator=(const Object &) -> Object & = delete;
   Object(Object &&) = delete;
   auto operator=(Object &&) -> Object & = delete;
 };
 
-class Integer : public Object {
-public:
-  const std::size_t value;
-  explicit Integer(const std::size_t val) : value(val) {}
-  [[nodiscard]] auto type() const -> ObjectType final;
-  [[nodiscard]] auto inspect() const -> std::string final;
-  [[nodiscard]] auto type_string() const -> std::string_view final;
-};
+// Integers, booleans and nulo are carried inline; only heap types such as
+// String and Function go through an Object pointer.
+class Value {
+  enum class Tag : std::uint8_t { _NULL, BOOLEAN, INTEGER, OBJECT, UNSET };
 
-class Boolean : public Object {
-public:
-  const bool value;
-  explicit Boolean(bool val) : value(val) {}
-  [[nodiscard]] auto type() const -> ObjectType final;
-  [[nodiscard]] auto inspect() const -> std::string final;
-  [[nodiscard]] auto type_string() const -> std::string_view final;
-};
+  Tag tag = Tag::_NULL;
+  union {
+    bool boolean;
+    std::int64_t integer;
+    Object *object;
+  } as{};
 
-class Null : public Object {
 public:
-  [[nodiscard]] auto type() const -> ObjectType final;
-  [[nodiscard]] auto inspect() const -> std::string final;
-  [[nodiscard]] auto type_string() const -> std::string_view final;
-};
+  constexpr Value() = default;
 
-class Return : public Object {
-public:
-  Object *value;
-  explicit Return(Object *val) : value(val) {}
-  [[nodiscard]] auto type() const -> ObjectType final;
-  [[nodiscard]] auto inspect() const -> std::string final;
-  [[nodiscard]] auto type_string() const -> std::string_view final;
+  [[nodiscard]] static constexpr auto make_boolean(bool val) -> Value
+  {
+    Value value;
+    value.tag = Tag::BOOLEAN;
+    value.as.boolean = val;
+    return value;
+  }
+
+  [[nodiscard]] static constexpr auto make_integer(std::int64_t val) -> Value
+  {
+    Value value;
+    value.tag = Tag::INTEGER;
+    value.as.integer = val;
+    return value;
+  }
+
+  [[nodiscard]] static constexpr auto make_object(Object *val) -> Value
+  {
+    Value value;
+    value.tag = Tag::OBJECT;
+    value.as.object = val;
+    return value;
+  }
+
+  // marks an environment slot that hasn't been assigned yet
+  [[nodiscard]] static constexpr auto make_unset() -> Value
+  {
+    Value value;
+    value.tag = Tag::UNSET;
+    return value;
+  }
+
+  [[nodiscard]] constexpr auto is_null() const -> bool
+  {
+    return tag == Tag::_NULL;
+  }
+  [[nodiscard]] constexpr auto is_boolean() const -> bool
+  {
+    return tag == Tag::BOOLEAN;
+  }
+  [[nodiscard]] constexpr auto is_integer() const -> bool
+  {
+    return tag == Tag::INTEGER;
+  }
+  [[nodiscard]] constexpr auto is_object() const -> bool
+  {
+    return tag == Tag::OBJECT;
+  }
+  [[nodiscard]] constexpr auto is_unset() const -> bool
+  {
+    return tag == Tag::UNSET;
+  }
+
+  [[nodiscard]] constexpr auto as_boolean() const -> bool
+  {
+    return as.boolean;
+  }
+  [[nodiscard]] constexpr auto as_integer() const -> std::int64_t
+  {
+    return as.integer;
+  }
+  [[nodiscard]] constexpr auto as_object() const -> Object *
+  {
+    return as.object;
+  }
+
+  [[nodiscard]] auto type() const -> ObjectType
+  {
+    switch (tag) {
+    case Tag::BOOLEAN:
+      return ObjectType::BOOLEAN;
+    case Tag::INTEGER:
+      return ObjectType::INTEGER;
+    case Tag::OBJECT:
+      return as.object->type();
+    default:
+      return ObjectType::_NULL;
+    }
+  }
+  [[nodiscard]] auto inspect() const -> std::string;
+  [[nodiscard]] auto type_string() const -> std::string_view;
 };
 
 class Error : public Object {
 public:
   const std::string message;
-  explicit Error(const std::string &msg) : message(msg) {}
-  [[nodiscard]] auto type() const -> ObjectType final;
+  explicit Error(const std::string &msg)
+      : Object(ObjectType::ERROR), message(msg)
+  {
+  }
   [[nodiscard]] auto inspect() const -> std::string final;
-  [[nodiscard]] auto type_string() const -> std::string_view final;
 };
 
 class Environment {
-  std::map<std::string, Object *> store;
+  std::vector<Value> slots;
   Environment *outer = nullptr;
+  const ast::Scope *scope;
+  // only the global environment owns its scope, which grows as new programs
+  // are resolved against it
+  std::unique_ptr<ast::Scope> globals_scope;
 
 public:
-  Environment() = default;
-  explicit Environment(Environment *outer) : outer(outer) {}
-  void set_item(const std::string &key, Object *value);
-  void del_item(const std::string &key);
-  auto get_item(const std::string &key) -> Object *;
-  auto item_exist(const std::string &key) -> bool;
+  std::uint32_t mark = 0;
+  // set on the frames the heap recycles instead of collecting
+  bool pooled = false;
+  Environment()
+      : scope(nullptr), globals_scope(std::make_unique<ast::Scope>())
+  {
+    scope = globals_scope.get();
+  }
+  Environment(Environment *parent, const ast::Scope *layout)
+      : slots(layout->size(), Value::make_unset()), outer(parent),
+        scope(layout)
+  {
+  }
+  [[nodiscard]] auto get_slot(std::size_t slot) const -> Value
+  {
+    return slot < slots.size() ? slots[slot] : Value::make_unset();
+  }
+  void set_slot(std::size_t slot, Value value)
+  {
+    if (slot >= slots.size()) {
+      slots.resize(slot + 1, Value::make_unset());
+    }
+    slots[slot] = value;
+  }
+  // a tail call back into the same procedimiento may take over the
+  // environment of the call it replaces, unless a closure could have kept it
+  [[nodiscard]] auto reusable_for(const Environment *parent,
+                                  const ast::Scope *layout) const -> bool
+  {
+    return outer == parent && scope == layout && !layout->is_captured();
+  }
+  void reset() { std::fill(slots.begin(), slots.end(), Value::make_unset()); }
+  // a recycled frame takes the layout of the call it is handed to, keeping
+  // the storage of its slots
+  void reuse(Environment *parent, const ast::Scope *layout)
+  {
+    outer = parent;
+    scope = layout;
+    slots.assign(layout->size(), Value::make_unset());
+  }
+  [[nodiscard]] auto ancestor(std::size_t depth) -> Environment *
+  {
+    auto *env = this;
+    for (; depth > 0; depth--) {
+      env = env->outer;
+    }
+    return env;
+  }
+  [[nodiscard]] auto lookup(Symbol name) const -> Value;
+  [[nodiscard]] auto globals() -> ast::Scope &;
+  [[nodiscard]] auto values() const -> const std::vector<Value> &
+  {
+    return slots;
+  }
+  [[nodiscard]] auto enclosing() const -> Environment * { return outer; }
 };
 
 class Function : public Object {
 public:
   std::vector<ast::Identifier *> parameters;
   ast::Block *body;
+  const ast::Scope *scope;
   Environment *env;
+  const FunctionProto *proto = nullptr;
+  // where the flat engine put the body, once it has flattened it
+  std::uint32_t flat_body = std::numeric_limits<std::uint32_t>::max();
   Function(const std::vector<ast::Identifier *> &params, ast::Block *blk,
-           Environment *env)
-      : parameters(params), body(blk), env(env) {}
-  [[nodiscard]] auto type() const -> ObjectType final;
-  [[nodiscard]] auto type_string() const -> std::string_view final;
+           const ast::Scope *scp, Environment *env)
+      : Object(ObjectType::FUNCTION), parameters(params), body(blk),
+        scope(scp), env(env)
+  {
+  }
   [[nodiscard]] auto inspect() const -> std::string final;
 };
 
+// The text is the first length bytes of a buffer that may be shared with
+// the strings it was concatenated from and to. Appending to the string that
+// ends the buffer writes in place, since no other string can see past its
+// own length, so building a string in a loop stays amortised linear.
 class String : public Object {
+  std::shared_ptr<std::string> buffer;
+  std::size_t length;
+  // bytes this string added to its buffer's capacity
+  std::size_t grown;
+  bool extendable = true;
+
 public:
-  const std::string value;
-  explicit String(const std::string &val) : value(val) {}
-  [[nodiscard]] auto type() const -> ObjectType final;
+  explicit String(std::string val)
+      : Object(ObjectType::STRING),
+        buffer(std::make_shared<std::string>(std::move(val))),
+        length(buffer->size()), grown(buffer->capacity())
+  {
+  }
+  // prefix followed by tail
+  String(const String &prefix, std::string_view tail);
+  // concatenations copy the text instead of appending to this buffer, for
+  // strings that live as long as the heap
+  void seal() { extendable = false; }
+  [[nodiscard]] auto buffer_bytes() const -> std::size_t { return grown; }
+  // only valid until the next concatenation that starts with this string
+  [[nodiscard]] auto value() const -> std::string_view
+  {
+    return {buffer->data(), length};
+  }
   [[nodiscard]] auto inspect() const -> std::string final;
-  [[nodiscard]] auto type_string() const -> std::string_view final;
 };
 
 using BuiltinFunction =
-    std::function<Object *(const std::vector<Object *> &, const int)>;
+    std::function<Value(const std::vector<Value> &, const int)>;
 
 class Builtin : public Object {
 public:
   const BuiltinFunction &fn;
-  explicit Builtin(const BuiltinFunction &builtin_fn) : fn(builtin_fn) {}
-  [[nodiscard]] auto type() const -> ObjectType final;
+  explicit Builtin(const BuiltinFunction &builtin_fn)
+      : Object(ObjectType::BUILTIN), fn(builtin_fn)
+  {
+  }
   [[nodiscard]] auto inspect() const -> std::string final;
-  [[nodiscard]] auto type_string() const -> std::string_view final;
-  Builtin(const Builtin &cpy) : fn(cpy.fn) {}
+  Builtin(const Builtin &cpy) : Object(ObjectType::BUILTIN), fn(cpy.fn) {}
 };
 
 } // namespace obj
@@ -0,0 +1,577 @@
+#include "optimizer.h"
+#include "ast.h"
+#include "evaluator.h"
+#include "gc.h"
+#include "object.h"
+#include "token.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+using namespace ast;
+using namespace std::string_view_literals;
+
+// nodes a procedimiento's body may have and still be copied into its calls
+static constexpr std::size_t MAX_INLINE_SIZE = 16;
+
+auto literal_value(Expression *expression) -> std::optional<obj::Value>
+{
+  switch (expression->type()) {
+  case Node::Integer:
+    return obj::Value::make_integer(static_cast<std::int64_t>(
+        static_cast<Integer *>(expression)->value));
+  case Node::Boolean:
+    return obj::Value::make_boolean(
+        static_cast<Boolean *>(expression)->value);
+  case Node::StringLiteral:
+    return obj::Value::make_object(
+        literal_string(static_cast<StringLiteral *>(expression)));
+  case Node::Null:
+    return obj::Value();
+  default:
+    return std::nullopt;
+  }
+}
+
+void Optimizer::optimize_program(Program *program)
+{
+  if (program->optimized) {
+    return;
+  }
+  if (program->arena == nullptr) {
+    program->arena = std::make_unique<Arena>();
+  }
+
+  arena = program->arena.get();
+  find_inlinable(program);
+  optimize_statements(program->statements);
+  inlinable.clear();
+  arena = nullptr;
+
+  program->optimized = true;
+}
+
+void Optimizer::optimize_statements(std::vector<Statement *> &statements)
+{
+  for (auto *&statement : statements) {
+    statement = optimize(statement);
+  }
+}
+
+auto Optimizer::optimize(Statement *statement) -> Statement *
+{
+  switch (statement->type()) {
+
+  case Node::ExpressionStatement: {
+    auto *cast_exp_st = static_cast<ExpressionStatement *>(statement);
+    cast_exp_st->expression = optimize(cast_exp_st->expression);
+    // blocks don't open scopes, so the branch taken can stand in for the si
+    if (cast_exp_st->expression->type() == Node::If) {
+      auto *cast_if = static_cast<If *>(cast_exp_st->expression);
+      if (cast_if->condition->type() == Node::Boolean &&
+          cast_if->alternative == nullptr) {
+        return cast_if->consequence;
+      }
+    }
+    return cast_exp_st;
+  }
+
+  case Node::Block:
+    optimize_statements(static_cast<Block *>(statement)->statements);
+    return statement;
+
+  case Node::LetStatement: {
+    auto *cast_let_st = static_cast<LetStatement *>(statement);
+    cast_let_st->value = optimize(cast_let_st->value);
+    return cast_let_st;
+  }
+
+  case Node::AssignStatement: {
+    auto *cast_assign = static_cast<AssignStatement *>(statement);
+    cast_assign->value = optimize(cast_assign->value);
+    return cast_assign;
+  }
+
+  case Node::ReturnStatement: {
+    auto *cast_rtn_st = static_cast<ReturnStatement *>(statement);
+    cast_rtn_st->return_value = optimize(cast_rtn_st->return_value);
+    return cast_rtn_st;
+  }
+
+  case Node::Loop: {
+    auto *cast_loop = static_cast<LoopStatement *>(statement);
+    cast_loop->condition = optimize(cast_loop->condition);
+    optimize_statements(cast_loop->repeat->statements);
+    return cast_loop;
+  }
+
+  default:
+    return statement;
+  }
+}
+
+auto Optimizer::optimize(Expression *expression) -> Expression *
+{
+  switch (expression->type()) {
+
+  case Node::Prefix:
+    return fold_prefix(static_cast<Prefix *>(expression));
+
+  case Node::Infix:
+    return fold_infix(static_cast<Infix *>(expression));
+
+  case Node::If:
+    return prune_if(static_cast<If *>(expression));
+
+  case Node::Function:
+    optimize_statements(static_cast<Function *>(expression)->body->statements);
+    return expression;
+
+  case Node::Call: {
+    auto *cast_call = static_cast<Call *>(expression);
+    cast_call->function = optimize(cast_call->function);
+    for (auto *&argument : cast_call->arguments) {
+      argument = optimize(argument);
+    }
+    inline_call(cast_call);
+    return cast_call;
+  }
+
+  default:
+    return expression;
+  }
+}
+
+using Bindings = std::unordered_map<Symbol, std::size_t>;
+
+static void count_bindings(Expression *expression, Bindings &bindings);
+
+// how many variable and assignment statements name each symbol
+static void count_bindings(Statement *statement, Bindings &bindings)
+{
+  switch (statement->type()) {
+  case Node::ExpressionStatement:
+    count_bindings(static_cast<ExpressionStatement *>(statement)->expression,
+                   bindings);
+    break;
+  case Node::Block:
+    for (auto *inner : static_cast<Block *>(statement)->statements) {
+      count_bindings(inner, bindings);
+    }
+    break;
+  case Node::LetStatement: {
+    auto *cast_let_st = static_cast<LetStatement *>(statement);
+    bindings[cast_let_st->name->symbol]++;
+    count_bindings(cast_let_st->value, bindings);
+    break;
+  }
+  case Node::AssignStatement: {
+    auto *cast_assign = static_cast<AssignStatement *>(statement);
+    bindings[cast_assign->name->symbol]++;
+    count_bindings(cast_assign->value, bindings);
+    break;
+  }
+  case Node::ReturnStatement:
+    count_bindings(static_cast<ReturnStatement *>(statement)->return_value,
+                   bindings);
+    break;
+  case Node::Loop: {
+    auto *cast_loop = static_cast<LoopStatement *>(statement);
+    count_bindings(cast_loop->condition, bindings);
+    count_bindings(cast_loop->repeat, bindings);
+    break;
+  }
+  default:
+    break;
+  }
+}
+
+static void count_bindings(Expression *expression, Bindings &bindings)
+{
+  switch (expression->type()) {
+  case Node::Prefix:
+    count_bindings(static_cast<Prefix *>(expression)->right, bindings);
+    break;
+  case Node::Infix: {
+    auto *cast_infix = static_cast<Infix *>(expression);
+    count_bindings(cast_infix->left, bindings);
+    count_bindings(cast_infix->right, bindings);
+    break;
+  }
+  case Node::If: {
+    auto *cast_if = static_cast<If *>(expression);
+    count_bindings(cast_if->condition, bindings);
+    count_bindings(cast_if->consequence, bindings);
+    if (cast_if->alternative != nullptr) {
+      count_bindings(cast_if->alternative, bindings);
+    }
+    break;
+  }
+  case Node::Function:
+    count_bindings(static_cast<Function *>(expression)->body, bindings);
+    break;
+  case Node::Call: {
+    auto *cast_call = static_cast<Call *>(expression);
+    count_bindings(cast_call->function, bindings);
+    for (auto *argument : cast_call->arguments) {
+      count_bindings(argument, bindings);
+    }
+    break;
+  }
+  default:
+    break;
+  }
+}
+
+// the one expression a procedimiento's body is, if that's all it is
+static auto body_expression(const Function *function) -> Expression *
+{
+  const auto &statements = function->body->statements;
+  if (statements.size() != 1) {
+    return nullptr;
+  }
+  switch (statements.front()->type()) {
+  case Node::ExpressionStatement:
+    return static_cast<ExpressionStatement *>(statements.front())->expression;
+  case Node::ReturnStatement:
+    return static_cast<ReturnStatement *>(statements.front())->return_value;
+  default:
+    return nullptr;
+  }
+}
+
+static auto parameter_index(const Function *function, Symbol name)
+    -> std::size_t
+{
+  const auto &parameters = function->parameters;
+  for (std::size_t i = 0; i < parameters.size(); i++) {
+    if (parameters.at(i)->symbol == name) {
+      return i;
+    }
+  }
+  return UNRESOLVED_SLOT;
+}
+
+static auto inline_size(Expression *expression, const Function *callee)
+    -> std::size_t;
+
+// a block of a si in a body that can be inlined holds one expression at most
+static auto inline_size(const Block *block, const Function *callee)
+    -> std::size_t
+{
+  const auto &statements = block->statements;
+  if (statements.empty()) {
+    return 1;
+  }
+  if (statements.size() > 1 ||
+      statements.front()->type() != Node::ExpressionStatement) {
+    return MAX_INLINE_SIZE + 1;
+  }
+  return 1 + inline_size(
+                 static_cast<ExpressionStatement *>(statements.front())
+                     ->expression,
+                 callee);
+}
+
+// The nodes in an expression, or more than MAX_INLINE_SIZE when it can't be
+// copied into a call: it may only read the callee's parameters, since any
+// other name could mean something else at the call, and it may not call
+// anything.
+static auto inline_size(Expression *expression, const Function *callee)
+    -> std::size_t
+{
+  switch (expression->type()) {
+  case Node::Integer:
+  case Node::Boolean:
+  case Node::Null:
+  case Node::StringLiteral:
+    return 1;
+  case Node::Identifier:
+    return parameter_index(callee,
+                           static_cast<Identifier *>(expression)->symbol) ==
+                   UNRESOLVED_SLOT
+               ? MAX_INLINE_SIZE + 1
+               : 1;
+  case Node::Prefix:
+    return 1 + inline_size(static_cast<Prefix *>(expression)->right, callee);
+  case Node::Infix: {
+    auto *cast_infix = static_cast<Infix *>(expression);
+    return 1 + inline_size(cast_infix->left, callee) +
+           inline_size(cast_infix->right, callee);
+  }
+  case Node::If: {
+    auto *cast_if = static_cast<If *>(expression);
+    auto size = 1 + inline_size(cast_if->condition, callee) +
+                inline_size(cast_if->consequence, callee);
+    if (cast_if->alternative != nullptr) {
+      size += inline_size(cast_if->alternative, callee);
+    }
+    return size;
+  }
+  default:
+    return MAX_INLINE_SIZE + 1;
+  }
+}
+
+static auto uses(Expression *expression, Symbol name) -> std::size_t;
+
+static auto uses(const Block *block, Symbol name) -> std::size_t
+{
+  std::size_t count = 0;
+  for (auto *statement : block->statements) {
+    count +=
+        uses(static_cast<ExpressionStatement *>(statement)->expression, name);
+  }
+  return count;
+}
+
+// how often an expression that can be inlined reads a name
+static auto uses(Expression *expression, Symbol name) -> std::size_t
+{
+  switch (expression->type()) {
+  case Node::Identifier:
+    return static_cast<Identifier *>(expression)->symbol == name ? 1 : 0;
+  case Node::Prefix:
+    return uses(static_cast<Prefix *>(expression)->right, name);
+  case Node::Infix: {
+    auto *cast_infix = static_cast<Infix *>(expression);
+    return uses(cast_infix->left, name) + uses(cast_infix->right, name);
+  }
+  case Node::If: {
+    auto *cast_if = static_cast<If *>(expression);
+    auto count =
+        uses(cast_if->condition, name) + uses(cast_if->consequence, name);
+    if (cast_if->alternative != nullptr) {
+      count += uses(cast_if->alternative, name);
+    }
+    return count;
+  }
+  default:
+    return 0;
+  }
+}
+
+// literals and names, which read the same however often they're evaluated
+static auto is_simple(Expression *expression) -> bool
+{
+  return literal_value(expression) || expression->type() == Node::Identifier;
+}
+
+// evaluating it changes nothing, so it may be evaluated later, more than once
+// or not at all
+static auto is_pure(Expression *expression) -> bool
+{
+  switch (expression->type()) {
+  case Node::Prefix:
+    return is_pure(static_cast<Prefix *>(expression)->right);
+  case Node::Infix: {
+    auto *cast_infix = static_cast<Infix *>(expression);
+    return is_pure(cast_infix->left) && is_pure(cast_infix->right);
+  }
+  default:
+    return is_simple(expression);
+  }
+}
+
+// variables the program binds once, to a procedimiento small enough to copy
+void Optimizer::find_inlinable(Program *program)
+{
+  Bindings bindings;
+  for (auto *statement : program->statements) {
+    count_bindings(statement, bindings);
+  }
+
+  for (auto *statement : program->statements) {
+    if (statement->type() != Node::LetStatement) {
+      continue;
+    }
+    auto *cast_let_st = static_cast<LetStatement *>(statement);
+    if (cast_let_st->value->type() != Node::Function ||
+        bindings[cast_let_st->name->symbol] != 1) {
+      continue;
+    }
+    auto *function = static_cast<Function *>(cast_let_st->value);
+    auto *body = body_expression(function);
+    if (body == nullptr || inline_size(body, function) > MAX_INLINE_SIZE) {
+      continue;
+    }
+    // with a repeated name, which parameter a read means is up to the slots
+    const auto &parameters = function->parameters;
+    bool repeated = false;
+    for (std::size_t i = 0; i < parameters.size(); i++) {
+      repeated = repeated ||
+                 parameter_index(function, parameters.at(i)->symbol) != i;
+    }
+    if (!repeated) {
+      inlinable.emplace(cast_let_st->name->symbol, function);
+    }
+  }
+}
+
+// Arguments are only copied in when evaluating them has no side effects, and
+// those read more than once only when they are literals or names, so the
+// copy neither changes what the call does nor does more work than it.
+void Optimizer::inline_call(Call *call)
+{
+  if (call->function->type() != Node::Identifier) {
+    return;
+  }
+  const auto itr =
+      inlinable.find(static_cast<Identifier *>(call->function)->symbol);
+  if (itr == inlinable.end()) {
+    return;
+  }
+  auto *callee = itr->second;
+  if (call->arguments.size() != callee->parameters.size()) {
+    return;
+  }
+
+  auto *body = body_expression(callee);
+  for (std::size_t i = 0; i < call->arguments.size(); i++) {
+    auto *argument = call->arguments.at(i);
+    if (!is_pure(argument) ||
+        (uses(body, callee->parameters.at(i)->symbol) > 1 &&
+         !is_simple(argument))) {
+      return;
+    }
+  }
+
+  call->inlined = optimize(substitute(body, callee, call->arguments));
+  call->inlined_body = callee->body;
+}
+
+// a copy of an expression that can be inlined, reading the arguments where it
+// read the parameters; literals never change, so the copy shares them
+auto Optimizer::substitute(Expression *expression, const Function *callee,
+                           const std::vector<Expression *> &arguments)
+    -> Expression *
+{
+  const auto copy_block = [&](const Block *block) {
+    std::vector<Statement *> statements;
+    for (auto *statement : block->statements) {
+      auto *cast_exp_st = static_cast<ExpressionStatement *>(statement);
+      statements.push_back(arena->make<ExpressionStatement>(
+          cast_exp_st->token,
+          substitute(cast_exp_st->expression, callee, arguments)));
+    }
+    return arena->make<Block>(block->token, statements);
+  };
+
+  switch (expression->type()) {
+  case Node::Identifier:
+    return arguments.at(parameter_index(
+        callee, static_cast<Identifier *>(expression)->symbol));
+  case Node::Prefix: {
+    auto *cast_prefix = static_cast<Prefix *>(expression);
+    return arena->make<Prefix>(
+        cast_prefix->token, cast_prefix->operatr, cast_prefix->op,
+        substitute(cast_prefix->right, callee, arguments));
+  }
+  case Node::Infix: {
+    auto *cast_infix = static_cast<Infix *>(expression);
+    return arena->make<Infix>(
+        cast_infix->token, substitute(cast_infix->left, callee, arguments),
+        cast_infix->operatr, cast_infix->op,
+        substitute(cast_infix->right, callee, arguments));
+  }
+  case Node::If: {
+    auto *cast_if = static_cast<If *>(expression);
+    return arena->make<If>(
+        cast_if->token, substitute(cast_if->condition, callee, arguments),
+        copy_block(cast_if->consequence),
+        cast_if->alternative != nullptr ? copy_block(cast_if->alternative)
+                                        : nullptr);
+  }
+  default:
+    return expression;
+  }
+}
+
+auto Optimizer::fold_prefix(Prefix *prefix) -> Expression *
+{
+  prefix->right = optimize(prefix->right);
+  const auto right = literal_value(prefix->right);
+  if (!right) {
+    return prefix;
+  }
+
+  const auto result =
+      evaluate_prefix_expression(prefix->op, *right, prefix->token.line);
+  return result.type() == obj::ObjectType::ERROR
+             ? prefix
+             : to_literal(result, prefix->token);
+}
+
+auto Optimizer::fold_infix(Infix *infix) -> Expression *
+{
+  infix->left = optimize(infix->left);
+  infix->right = optimize(infix->right);
+  const auto left = literal_value(infix->left);
+  const auto right = literal_value(infix->right);
+  if (!left || !right) {
+    return infix;
+  }
+
+  const auto result =
+      evaluate_infix_expression(infix->op, *left, *right, infix->token.line);
+  return result.type() == obj::ObjectType::ERROR
+             ? infix
+             : to_literal(result, infix->token);
+}
+
+// A literal condition picks its branch now: the si is left with a verdadero
+// condition and that branch alone, or becomes nulo when there's none.
+auto Optimizer::prune_if(If *if_expression) -> Expression *
+{
+  if_expression->condition = optimize(if_expression->condition);
+  optimize_statements(if_expression->consequence->statements);
+  if (if_expression->alternative != nullptr) {
+    optimize_statements(if_expression->alternative->statements);
+  }
+
+  const auto condition = literal_value(if_expression->condition);
+  if (!condition) {
+    return if_expression;
+  }
+
+  auto *branch = is_truthy(*condition) ? if_expression->consequence
+                                       : if_expression->alternative;
+  if (branch == nullptr) {
+    return to_literal(obj::Value(), if_expression->token);
+  }
+  if_expression->condition =
+      to_literal(obj::Value::make_boolean(true), if_expression->token);
+  if_expression->consequence = branch;
+  if_expression->alternative = nullptr;
+  return if_expression;
+}
+
+// The node keeps the line of the expression it replaces. The literals of
+// folded integers and strings have no text in the source, so their token
+// keeps the original one and only to_string shows the value.
+auto Optimizer::to_literal(obj::Value value, const Token &token)
+    -> Expression *
+{
+  const auto line = token.line;
+  switch (value.type()) {
+  case obj::ObjectType::INTEGER:
+    return arena->make<Integer>(Token(TokenType::INT, token.literal, line),
+                                static_cast<std::size_t>(value.as_integer()));
+  case obj::ObjectType::BOOLEAN:
+    return value.as_boolean()
+               ? arena->make<Boolean>(
+                     Token(TokenType::_TRUE, "verdadero"sv, line), true)
+               : arena->make<Boolean>(
+                     Token(TokenType::_FALSE, "falso"sv, line), false);
+  case obj::ObjectType::STRING:
+    return arena->make<StringLiteral>(
+        Token(TokenType::STRING, token.literal, line),
+        static_cast<obj::String *>(value.as_object())->value());
+  default:
+    return arena->make<Null>(Token(TokenType::_NULL, "nulo"sv, line));
+  }
+}
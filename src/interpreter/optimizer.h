@@ -0,0 +1,50 @@
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+#include "ast.h"
+#include "object.h"
+#include "symbol.h"
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+// Folds operators whose operands are literals into the literal they evaluate
+// to, and drops the branch a literal si condition never takes, before either
+// engine runs the program. An operation that would fail, like a division by
+// zero, is left in place so it still fails at runtime on its own line.
+//
+// Calls to a small procedimiento that a variable of the program is bound to,
+// once and for good, also get a copy of its body with the arguments put in
+// for the parameters. Only bodies that are one expression over their
+// parameters qualify, and only arguments without side effects are copied in,
+// so evaluating the copy gives what the call would.
+class Optimizer {
+private:
+  ast::Arena *arena = nullptr;
+  // the procedimientos calls may be inlined to, by the name bound to them
+  std::unordered_map<Symbol, ast::Function *> inlinable;
+
+  void find_inlinable(ast::Program *program);
+  void inline_call(ast::Call *call);
+  auto substitute(ast::Expression *expression, const ast::Function *callee,
+                  const std::vector<ast::Expression *> &arguments)
+      -> ast::Expression *;
+
+  void optimize_statements(std::vector<ast::Statement *> &statements);
+  auto optimize(ast::Statement *statement) -> ast::Statement *;
+  auto optimize(ast::Expression *expression) -> ast::Expression *;
+  auto fold_prefix(ast::Prefix *prefix) -> ast::Expression *;
+  auto fold_infix(ast::Infix *infix) -> ast::Expression *;
+  auto prune_if(ast::If *if_expression) -> ast::Expression *;
+  auto to_literal(obj::Value value, const Token &token) -> ast::Expression *;
+
+public:
+  Optimizer() = default;
+  // does nothing when the program was already optimized
+  void optimize_program(ast::Program *program);
+};
+
+// the value of a literal node, nothing for any other expression
+auto literal_value(ast::Expression *expression)
+    -> std::optional<obj::Value>;
+
+#endif // OPTIMIZER_H
@@ -3,10 +3,15 @@
 #include "lexer.h"
 #include "token.h"
 #include "utils.h"
+#include <array>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
 #include <fmt/format.h>
 #include <memory>
-#include <stdexcept>
 #include <string>
+#include <system_error>
+#include <utility>
 #include <vector>
 
 using namespace std;
@@ -14,8 +19,7 @@ using namespace ast;
 
 Parser::Parser(const Lexer &lxr) : lexer(lxr)
 {
-  prefix_parse_fns = register_prefix_fns();
-  infix_parse_fns = register_infix_fns();
+  arena->keep_alive(lexer.source_buffer());
   advance_tokens();
   advance_tokens();
 }
@@ -55,7 +59,7 @@ auto Parser::parse_statement() -> Statement *
 
 auto Parser::parse_let_statement() -> LetStatement *
 {
-  auto let_statement = make_unique<LetStatement>(current_token);
+  auto *let_statement = arena->make<LetStatement>(current_token);
 
   if (!expected_token(TokenType::IDENT)) {
     return nullptr;
@@ -74,12 +78,12 @@ auto Parser::parse_let_statement() -> LetStatement *
     advance_tokens();
   }
 
-  return let_statement.release();
+  return let_statement;
 }
 
 auto Parser::parse_while_statement() -> LoopStatement *
 {
-  auto loop_statement = std::make_unique<ast::LoopStatement>(current_token);
+  auto *loop_statement = arena->make<LoopStatement>(current_token);
 
   if (!expected_token(TokenType::LPAREN)) {
     return nullptr;
@@ -97,12 +101,12 @@ auto Parser::parse_while_statement() -> LoopStatement *
   }
   loop_statement->repeat = parse_block();
 
-  return loop_statement.release();
+  return loop_statement;
 }
 
 auto Parser::parse_return_statement() -> ReturnStatement *
 {
-  auto return_statement = make_unique<ReturnStatement>(current_token);
+  auto *return_statement = arena->make<ReturnStatement>(current_token);
   advance_tokens();
 
   return_statement->return_value = parse_expression(Precedence::LOWEST);
@@ -111,50 +115,46 @@ auto Parser::parse_return_statement() -> ReturnStatement *
     advance_tokens();
   }
 
-  return return_statement.release();
+  return return_statement;
 }
 
 auto Parser::parse_expression_statements() -> ExpressionStatement *
 {
-  auto expression_statement = make_unique<ExpressionStatement>(current_token);
+  auto *expression_statement =
+      arena->make<ExpressionStatement>(current_token);
 
   expression_statement->expression = parse_expression(Precedence::LOWEST);
   if (peek_token.token_type == TokenType::SEMICOLON) {
     advance_tokens();
   }
 
-  return expression_statement.release();
+  return expression_statement;
 }
 
 auto Parser::parse_expression(Precedence precedence) -> Expression *
 {
-  try {
-    auto prefix_parse_fn = prefix_parse_fns[current_token.token_type];
-    auto *left_expression = prefix_parse_fn();
-
-    while (peek_token.token_type != TokenType::SEMICOLON &&
-           precedence < get_precedence(peek_token.token_type)) {
-      auto infix_parse_fn = infix_parse_fns[peek_token.token_type];
-      advance_tokens();
-      if (left_expression != nullptr) {
-        left_expression = infix_parse_fn(left_expression);
-      }
-    }
-    return left_expression;
-  }
-  catch (...) {
-    auto error = fmt::format(
-        "No se encontró ninguna función para parsear {} cerca de la línea {}\n",
-        current_token.literal, current_token.line);
-    errors_list.push_back(error);
+  const auto prefix_parse_fn = parse_rule(current_token.token_type).prefix;
+  if (prefix_parse_fn == nullptr) {
+    no_prefix_parse_fn_error();
     return nullptr;
   }
+  auto *left_expression = (this->*prefix_parse_fn)();
+
+  while (peek_token.token_type != TokenType::SEMICOLON &&
+         precedence < get_precedence(peek_token.token_type)) {
+    const auto infix_parse_fn = parse_rule(peek_token.token_type).infix;
+    advance_tokens();
+    if (left_expression != nullptr) {
+      left_expression = (this->*infix_parse_fn)(left_expression);
+    }
+  }
+  return left_expression;
 }
 
 auto Parser::parse_block() -> Block *
 {
-  auto block_statement =
-      make_unique<Block>(current_token, vector<Statement *>());
+  auto *block_statement =
+      arena->make<Block>(current_token, vector<Statement *>());
   advance_tokens();
 
   while (current_token.token_type != TokenType::RBRACE &&
@@ -165,7 +165,7 @@ auto Parser::parse_block() -> Block *
     }
     advance_tokens();
   }
-  return block_statement.release();
+  return block_statement;
 }
 
 auto Parser::parse_function_parameters() -> vector<Identifier *>
@@ -176,13 +176,15 @@ auto Parser::parse_function_parameters() -> vector<Identifier *>
     return params;
   }
   advance_tokens();
-  auto *identifier = new Identifier(current_token, current_token.literal);
+  auto *identifier =
+      arena->make<Identifier>(current_token, current_token.literal);
   params.push_back(identifier);
 
   while (peek_token.token_type == TokenType::COMMA) {
     advance_tokens();
     advance_tokens();
-    auto *identifiers = new Identifier(current_token, current_token.literal);
+    auto *identifiers =
+        arena->make<Identifier>(current_token, current_token.literal);
     params.push_back(identifiers);
   }
 
@@ -242,6 +244,13 @@ void Parser::advance_tokens()
 
 auto Parser::errors() -> vector<string> & { return errors_list; }
 
+auto Parser::take_arena() -> unique_ptr<Arena>
+{
+  auto nodes = std::exchange(arena, make_unique<Arena>());
+  arena->keep_alive(lexer.source_buffer());
+  return nodes;
+}
+
 void Parser::expected_token_error(const TokenType &tkn_tp)
 {
   auto error =
@@ -253,32 +262,173 @@ void Parser::expected_token_error(const TokenType &tkn_tp)
   errors_list.push_back(error);
 }
 
-auto Parser::register_prefix_fns() -> PrefixParseFns
+void Parser::no_prefix_parse_fn_error()
+{
+  auto error = fmt::format(
+      "No se encontró ninguna función para parsear {} cerca de la línea {}\n",
+      current_token.literal, current_token.line);
+  errors_list.push_back(error);
+}
+
+auto Parser::parse_rule(const TokenType &tkn_tp) -> const ParseRule &
+{
+  static constexpr auto RULES = [] {
+    array<ParseRule, TOKEN_TYPE_COUNT> rules{};
+    const auto rule = [&rules](TokenType type) -> ParseRule & {
+      return rules.at(static_cast<size_t>(type));
+    };
+
+    rule(TokenType::FUNCTION).prefix = &Parser::parse_function;
+    rule(TokenType::_FALSE).prefix = &Parser::parse_boolean;
+    rule(TokenType::_TRUE).prefix = &Parser::parse_boolean;
+    rule(TokenType::_NULL).prefix = &Parser::parse_null;
+    rule(TokenType::IDENT).prefix = &Parser::parse_identifier;
+    rule(TokenType::IF).prefix = &Parser::parse_if;
+    rule(TokenType::INT).prefix = &Parser::parse_integer;
+    rule(TokenType::MINUS).prefix = &Parser::parse_prefix_expression;
+    rule(TokenType::NEGATION).prefix = &Parser::parse_prefix_expression;
+    rule(TokenType::LPAREN).prefix = &Parser::parse_grouped_expression;
+    rule(TokenType::STRING).prefix = &Parser::parse_string_literal;
+
+    // every token with a precedence continues an expression
+    for (const auto &[type, precedence] : precedence_values) {
+      rule(type).infix = &Parser::parse_infix_expression;
+      rule(type).precedence = precedence;
+    }
+    rule(TokenType::LPAREN).infix = &Parser::parse_call;
+
+    return rules;
+  }();
+
+  return RULES.at(static_cast<size_t>(tkn_tp));
+}
+
+auto Parser::parse_identifier() -> Expression *
+{
+  return arena->make<Identifier>(current_token, current_token.literal);
+}
+
+auto Parser::parse_integer() -> Expression *
+{
+  const auto literal = current_token.literal;
+  std::int64_t value = 0;
+  const auto [ptr, ec] =
+      from_chars(literal.data(), literal.data() + literal.size(), value);
+  if (ec != errc()) {
+    errors_list.push_back(
+        fmt::format("No se pudo parsear {} como entero cerca de la línea {}\n",
+                    literal, current_token.line));
+    return nullptr;
+  }
+  return arena->make<Integer>(current_token, static_cast<size_t>(value));
+}
+
+auto Parser::parse_prefix_expression() -> Expression *
+{
+  auto *prefix_expression =
+      arena->make<Prefix>(current_token, current_token.literal,
+                          get_operator(current_token.token_type));
+
+  advance_tokens();
+  prefix_expression->right = parse_expression(Precedence::PREFIX);
+
+  return prefix_expression;
+}
+
+auto Parser::parse_boolean() -> Expression *
 {
-  return {{TokenType::FUNCTION, parse_function},
-          {TokenType::_FALSE, parse_boolean},
-          {TokenType::_TRUE, parse_boolean},
-          {TokenType::_NULL, parse_null},
-          {TokenType::IDENT, parse_identifier},
-          {TokenType::IF, parse_if},
-          {TokenType::INT, parse_integer},
-          {TokenType::MINUS, parse_prefix_expression},
-          {TokenType::NEGATION, parse_prefix_expression},
-          {TokenType::LPAREN, parse_grouped_expression},
-          {TokenType::STRING, parse_string_literal}};
+  return arena->make<Boolean>(current_token,
+                              current_token.token_type == TokenType::_TRUE);
 }
 
-auto Parser::register_infix_fns() -> InfixParseFns
+auto Parser::parse_null() -> Expression *
 {
-  return {{TokenType::PLUS, parse_infix_expression},
-          {TokenType::MINUS, parse_infix_expression},
-          {TokenType::DIVISION, parse_infix_expression},
-          {TokenType::MULTIPLICATION, parse_infix_expression},
-          {TokenType::EQ, parse_infix_expression},
-          {TokenType::NOT_EQ, parse_infix_expression},
-          {TokenType::LT, parse_infix_expression},
-          {TokenType::GT, parse_infix_expression},
-          {TokenType::LPAREN, parse_call}};
+  return arena->make<Null>(current_token);
+}
+
+auto Parser::parse_grouped_expression() -> Expression *
+{
+  advance_tokens();
+  auto *expression = parse_expression(Precedence::LOWEST);
+
+  if (!expected_token(TokenType::RPAREN)) {
+    return nullptr;
+  }
+
+  return expression;
+}
+
+auto Parser::parse_if() -> Expression *
+{
+  auto *if_expression = arena->make<If>(current_token);
+
+  if (!expected_token(TokenType::LPAREN)) {
+    return nullptr;
+  }
+  advance_tokens();
+
+  if_expression->condition = parse_expression(Precedence::LOWEST);
+
+  if (!expected_token(TokenType::RPAREN)) {
+    return nullptr;
+  }
+
+  if (!expected_token(TokenType::LBRACE)) {
+    return nullptr;
+  }
+  if_expression->consequence = parse_block();
+
+  if (peek_token.token_type == TokenType::ELSE) {
+    advance_tokens();
+    if (!expected_token(TokenType::LBRACE)) {
+      return nullptr;
+    }
+    if_expression->alternative = parse_block();
+  }
+
+  return if_expression;
+}
+
+auto Parser::parse_function() -> Expression *
+{
+  auto *function = arena->make<Function>(current_token);
+  if (!expected_token(TokenType::LPAREN)) {
+    return nullptr;
+  }
+  function->parameters = parse_function_parameters();
+
+  if (!expected_token(TokenType::LBRACE)) {
+    return nullptr;
+  }
+
+  function->body = parse_block();
+
+  return function;
+}
+
+auto Parser::parse_string_literal() -> Expression *
+{
+  return arena->make<StringLiteral>(current_token, current_token.literal);
+}
+
+auto Parser::parse_infix_expression(Expression *left) -> Expression *
+{
+  auto *infix =
+      arena->make<Infix>(current_token, left, current_token.literal,
+                         get_operator(current_token.token_type));
+
+  auto precedence = get_precedence(current_token.token_type);
+  advance_tokens();
+  infix->right = parse_expression(precedence);
+
+  return infix;
+}
+
+auto Parser::parse_call(Expression *function) -> Expression *
+{
+  auto *call = arena->make<Call>(current_token, function);
+  call->arguments = parse_call_arguments();
+  return call;
 }
 
 auto Parser::parse_assign_statement() -> AssignStatement *
@@ -296,17 +446,19 @@ auto Parser::parse_assign_statement() -> AssignStatement *
     advance_tokens();
   }
 
-  return new AssignStatement(token, name, value);
+  return arena->make<AssignStatement>(token, name, value);
 }
 
 auto Parser::get_precedence(const TokenType &tkn_tp) -> Precedence
 {
-  static constexpr auto PRECEDENCES =
-      Map<TokenType, Precedence, precedence_values.size()>{{precedence_values}};
+  return parse_rule(tkn_tp).precedence;
+}
 
-  if (PRECEDENCES.find(tkn_tp)) {
-    return PRECEDENCES.at(tkn_tp);
-  }
+auto Parser::get_operator(const TokenType &tkn_tp) -> ast::Operator
+{
+  static constexpr auto OPERATORS =
+      PerfectMap<TokenType, ast::Operator, operator_values.size()>{
+          operator_values};
 
-  return Precedence::LOWEST;
+  return *OPERATORS.find(tkn_tp);
 }
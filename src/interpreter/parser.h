@@ -4,21 +4,17 @@
 #include "fmt/format.h"
 #include "lexer.h"
 #include "token.h"
+#include <array>
 #include <cstddef>
-#include <cstdlib>
-#include <functional>
-#include <map>
 #include <memory>
-#include <new>
-#include <stdexcept>
 #include <string>
+#include <utility>
 #include <vector>
 
-using PrefixParseFn = std::function<ast::Expression *()>;
-using InfixParseFn = std::function<ast::Expression *(ast::Expression *)>;
+class Parser;
 
-using PrefixParseFns = std::map<TokenType, PrefixParseFn>;
-using InfixParseFns = std::map<TokenType, InfixParseFn>;
+using PrefixParseFn = ast::Expression *(Parser::*)();
+using InfixParseFn = ast::Expression *(Parser::*)(ast::Expression *);
 
 enum class Precedence {
   LOWEST,
@@ -41,14 +37,33 @@ static constexpr std::array<std::pair<TokenType, Precedence>, 9>
                        {TokenType::MULTIPLICATION, Precedence::PRODUC},
                        {TokenType::LPAREN, Precedence::CALL}}};
 
+static constexpr std::array<std::pair<TokenType, ast::Operator>, 9>
+    operator_values{{{TokenType::PLUS, ast::Operator::PLUS},
+                     {TokenType::MINUS, ast::Operator::MINUS},
+                     {TokenType::MULTIPLICATION, ast::Operator::MULTIPLICATION},
+                     {TokenType::DIVISION, ast::Operator::DIVISION},
+                     {TokenType::EQ, ast::Operator::EQ},
+                     {TokenType::NOT_EQ, ast::Operator::NOT_EQ},
+                     {TokenType::LT, ast::Operator::LT},
+                     {TokenType::GT, ast::Operator::GT},
+                     {TokenType::NEGATION, ast::Operator::NEGATION}}};
+
+// How a token is parsed at the start of an expression and after one; a null
+// function means the token can't appear there.
+struct ParseRule {
+  PrefixParseFn prefix = nullptr;
+  InfixParseFn infix = nullptr;
+  Precedence precedence = Precedence::LOWEST;
+};
+
 class Parser {
 private:
   Lexer lexer;
   Token current_token;
   Token peek_token;
-  PrefixParseFns prefix_parse_fns;
-  InfixParseFns infix_parse_fns;
   std::vector<std::string> errors_list;
+  // every node of the programs parsed since the last take_arena
+  std::unique_ptr<ast::Arena> arena = std::make_unique<ast::Arena>();
 
   auto parse_statement() -> ast::Statement *;
   auto parse_let_statement() -> ast::LetStatement *;
@@ -63,126 +78,28 @@ private:
   auto expected_token(const TokenType &) -> bool;
   void advance_tokens();
   void expected_token_error(const TokenType &);
-  auto register_infix_fns() -> InfixParseFns;
-  auto register_prefix_fns() -> PrefixParseFns;
+  void no_prefix_parse_fn_error();
+  auto parse_identifier() -> ast::Expression *;
+  auto parse_integer() -> ast::Expression *;
+  auto parse_prefix_expression() -> ast::Expression *;
+  auto parse_boolean() -> ast::Expression *;
+  auto parse_null() -> ast::Expression *;
+  auto parse_grouped_expression() -> ast::Expression *;
+  auto parse_if() -> ast::Expression *;
+  auto parse_function() -> ast::Expression *;
+  auto parse_string_literal() -> ast::Expression *;
+  auto parse_infix_expression(ast::Expression *) -> ast::Expression *;
+  auto parse_call(ast::Expression *) -> ast::Expression *;
+  static auto parse_rule(const TokenType &) -> const ParseRule &;
   static auto get_precedence(const TokenType &) -> Precedence;
+  static auto get_operator(const TokenType &) -> ast::Operator;
 
 public:
   explicit Parser(const Lexer &lxr);
   auto parse_program() -> std::vector<ast::Statement *>;
   auto errors() -> std::vector<std::string> &;
-
-private:
-  PrefixParseFn parse_identifier = [&]() -> ast::Expression * {
-    return new ast::Identifier(current_token, current_token.literal);
-  };
-
-  PrefixParseFn parse_integer = [&]() -> ast::Expression * {
-    return new ast::Integer(current_token, static_cast<std::size_t>(std::stoi(
-                                               current_token.literal)));
-  };
-
-  PrefixParseFn parse_prefix_expression = [&]() -> ast::Expression * {
-    auto prefix_expression =
-        std::make_unique<ast::Prefix>(current_token, current_token.literal);
-
-    advance_tokens();
-    prefix_expression->right = parse_expression(Precedence::PREFIX);
-
-    return prefix_expression.release();
-  };
-
-  PrefixParseFn parse_boolean = [&]() -> ast::Expression * {
-    return new ast::Boolean(current_token,
-                            current_token.token_type == TokenType::_TRUE);
-  };
-
-  PrefixParseFn parse_null = [&]() -> ast::Expression * {
-    return new ast::Null(current_token);
-  };
-
-  PrefixParseFn parse_grouped_expression = [&]() -> ast::Expression * {
-    advance_tokens();
-    auto expression =
-        std::unique_ptr<ast::Expression>(parse_expression(Precedence::LOWEST));
-
-    if (!expected_token(TokenType::RPAREN)) {
-      return nullptr;
-    }
-
-    return expression.release();
-  };
-
-  PrefixParseFn parse_if = [&]() -> ast::Expression * {
-    auto if_expression = std::make_unique<ast::If>(current_token);
-
-    if (!expected_token(TokenType::LPAREN)) {
-      return nullptr;
-    }
-    advance_tokens();
-
-    if_expression->condition = parse_expression(Precedence::LOWEST);
-
-    if (!expected_token(TokenType::RPAREN)) {
-      return nullptr;
-    }
-
-    if (!expected_token(TokenType::LBRACE)) {
-      return nullptr;
-    }
-    if_expression->consequence = parse_block();
-
-    if (peek_token.token_type == TokenType::ELSE) {
-      advance_tokens();
-      if (!expected_token(TokenType::LBRACE)) {
-        return nullptr;
-      }
-      if_expression->alternative = parse_block();
-    }
-
-    return if_expression.release();
-  };
-
-  PrefixParseFn parse_function = [&]() -> ast::Expression * {
-    auto function = std::make_unique<ast::Function>(current_token);
-    if (!expected_token(TokenType::LPAREN)) {
-      return nullptr;
-    }
-    function->parameters = parse_function_parameters();
-
-    if (!expected_token(TokenType::LBRACE)) {
-      return nullptr;
-    }
-
-    function->body = parse_block();
-
-    return function.release();
-  };
-
-  PrefixParseFn parse_string_literal = [&]() -> ast::Expression * {
-    auto string_literal = std::make_unique<ast::StringLiteral>(
-        current_token, current_token.literal);
-    return string_literal.release();
-  };
-
-  InfixParseFn parse_infix_expression =
-      [&](ast::Expression *left) -> ast::Expression * {
-    auto infix = std::make_unique<ast::Infix>(current_token, left,
-                                              current_token.literal);
-
-    auto precedence = get_precedence(current_token.token_type);
-    advance_tokens();
-    infix->right = parse_expression(precedence);
-
-    return infix.release();
-  };
-
-  InfixParseFn parse_call =
-      [&](ast::Expression *function) -> ast::Expression * {
-    auto call = std::make_unique<ast::Call>(current_token, function);
-    call->arguments = parse_call_arguments();
-    return call.release();
-  };
+  // hands over the nodes parsed so far, for the Program that will own them
+  auto take_arena() -> std::unique_ptr<ast::Arena>;
 };
 
 #endif // PARSER_H
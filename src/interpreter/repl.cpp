@@ -1,8 +1,10 @@
 #include "repl.h"
 #include "ast.h"
 #include "evaluator.h"
+#include "flat.h"
 #include "fmt/core.h"
 #include "object.h"
+#include "vm.h"
 #include <iostream>
 #include <memory>
 #include <string>
@@ -17,25 +19,37 @@ void print_parser_errors(const std::vector<std::string> &errors)
     std::cout << error;
   }
 }
-void start_repl()
+void start_repl(Engine engine)
 {
   auto env = std::make_unique<Environment>();
   Programs_Guard guard;
+  VM machine;
+  FlatEvaluator flat;
   for (std::string instruction; instruction != "salir()";
        getline(std::cin, instruction)) {
     Lexer lexer(instruction);
     Parser parser(lexer);
-    auto *program = guard.new_program(parser.parse_program());
+    auto statements = parser.parse_program();
+    auto *program = guard.new_program(statements, parser.take_arena());
     if (!parser.errors().empty()) {
       print_parser_errors(parser.errors());
       fmt::print("\n>> ");
       continue;
     }
 
-    auto *evaluated = evaluate(program, env.get());
+    obj::Value evaluated;
+    if (engine == Engine::VM) {
+      evaluated = machine.run(program, env.get());
+    }
+    else if (engine == Engine::FLAT) {
+      evaluated = flat.run(program, env.get());
+    }
+    else {
+      evaluated = evaluate(program, env.get());
+    }
 
-    if (evaluated != nullptr) {
-      fmt::print("{}", evaluated->inspect());
+    if (!program->statements.empty()) {
+      fmt::print("{}", evaluated.inspect());
     }
     fmt::print("\n>> ");
   }
@@ -1,6 +1,7 @@
 #ifndef REPL_H
 #define REPL_H
+#include "vm.h"
 
-void start_repl();
+void start_repl(Engine engine = Engine::AST);
 
 #endif // REPL_H
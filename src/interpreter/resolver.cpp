@@ -0,0 +1,180 @@
+#include "resolver.h"
+#include "ast.h"
+#include <cstddef>
+#include <vector>
+
+using namespace ast;
+
+void Resolver::resolve_program(Program *program, Scope &globals)
+{
+  if (program->resolved_scope == &globals) {
+    return;
+  }
+
+  scopes.push_back(&globals);
+  walk_statements(program->statements, Pass::DECLARE);
+  walk_statements(program->statements, Pass::RESOLVE);
+  scopes.pop_back();
+
+  program->resolved_scope = &globals;
+}
+
+void Resolver::walk_statements(const std::vector<Statement *> &statements,
+                               Pass pass)
+{
+  for (auto *statement : statements) {
+    walk(statement, pass);
+  }
+}
+
+void Resolver::walk(ASTNode *node, Pass pass)
+{
+  switch (node->type()) {
+
+  case Node::ExpressionStatement:
+    walk(static_cast<ExpressionStatement *>(node)->expression, pass);
+    break;
+
+  case Node::Block:
+    walk_statements(static_cast<Block *>(node)->statements, pass);
+    break;
+
+  case Node::LetStatement: {
+    auto *cast_let_st = static_cast<LetStatement *>(node);
+    resolve_name(cast_let_st->name, pass);
+    walk(cast_let_st->value, pass);
+    break;
+  }
+
+  case Node::AssignStatement: {
+    auto *cast_assign = static_cast<AssignStatement *>(node);
+    resolve_name(cast_assign->name, pass);
+    walk(cast_assign->value, pass);
+    break;
+  }
+
+  case Node::ReturnStatement: {
+    auto *cast_rtn_st = static_cast<ReturnStatement *>(node);
+    walk(cast_rtn_st->return_value, pass);
+    if (pass == Pass::RESOLVE) {
+      resolve_return(cast_rtn_st);
+    }
+    break;
+  }
+
+  case Node::Loop: {
+    auto *cast_loop = static_cast<LoopStatement *>(node);
+    loops++;
+    walk(cast_loop->condition, pass);
+    walk(cast_loop->repeat, pass);
+    loops--;
+    break;
+  }
+
+  case Node::If: {
+    auto *cast_if = static_cast<If *>(node);
+    walk(cast_if->condition, pass);
+    walk(cast_if->consequence, pass);
+    if (cast_if->alternative != nullptr) {
+      walk(cast_if->alternative, pass);
+    }
+    break;
+  }
+
+  case Node::Prefix:
+    walk(static_cast<Prefix *>(node)->right, pass);
+    break;
+
+  case Node::Infix: {
+    auto *cast_infix = static_cast<Infix *>(node);
+    walk(cast_infix->left, pass);
+    walk(cast_infix->right, pass);
+    break;
+  }
+
+  case Node::Call: {
+    auto *cast_call = static_cast<Call *>(node);
+    walk(cast_call->function, pass);
+    for (auto *arg : cast_call->arguments) {
+      walk(arg, pass);
+    }
+    break;
+  }
+
+  case Node::Identifier:
+    if (pass == Pass::RESOLVE) {
+      resolve_identifier(static_cast<Identifier *>(node));
+    }
+    break;
+
+  case Node::Function:
+    // a procedimiento opens its own scope, resolved once its enclosing
+    // scope knows all of its variables
+    if (pass == Pass::RESOLVE) {
+      resolve_function(static_cast<Function *>(node));
+    }
+    break;
+
+  default:
+    break;
+  }
+}
+
+void Resolver::resolve_name(Identifier *name, Pass pass)
+{
+  // assignments always land in the current procedimiento's environment
+  if (pass == Pass::DECLARE) {
+    scopes.back()->declare(name->symbol);
+  }
+  else {
+    name->depth = 0;
+    name->slot = scopes.back()->find(name->symbol);
+  }
+}
+
+void Resolver::resolve_function(Function *function)
+{
+  scopes.back()->mark_captured();
+  const auto enclosing_loops = loops;
+  loops = 0;
+  scopes.push_back(&function->scope);
+  for (auto *param : function->parameters) {
+    resolve_name(param, Pass::DECLARE);
+  }
+  walk(function->body, Pass::DECLARE);
+  for (auto *param : function->parameters) {
+    resolve_name(param, Pass::RESOLVE);
+  }
+  walk(function->body, Pass::RESOLVE);
+  scopes.pop_back();
+  loops = enclosing_loops;
+}
+
+void Resolver::resolve_return(ReturnStatement *return_statement)
+{
+  // a regresa inside a mientras only ends the iteration, and one outside of
+  // any procedimiento ends the program, so neither can give up its frame;
+  // an inlined call has no frame of its own to give it to
+  auto *value = return_statement->return_value;
+  return_statement->tail_call =
+      scopes.size() > 1 && loops == 0 && value->type() == Node::Call &&
+      static_cast<Call *>(value)->inlined == nullptr;
+}
+
+void Resolver::resolve_identifier(Identifier *identifier)
+{
+  for (std::size_t depth = 0; depth < scopes.size(); depth++) {
+    auto *scope = scopes.at(scopes.size() - 1 - depth);
+    const auto slot = scope->find(identifier->symbol);
+    if (slot != UNRESOLVED_SLOT) {
+      identifier->depth = depth;
+      identifier->slot = slot;
+      return;
+    }
+  }
+
+  // names nobody assigns yet become globals, so a later program in the same
+  // session can still define them; until then reads fall back to builtins
+  identifier->depth = scopes.size() - 1;
+  identifier->slot = scopes.front()->declare(identifier->symbol);
+}
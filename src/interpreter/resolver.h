@@ -0,0 +1,35 @@
+#ifndef RESOLVER_H
+#define RESOLVER_H
+#include "ast.h"
+#include <cstddef>
+#include <vector>
+
+// Gives every identifier the (depth, slot) of the variable it names, so the
+// engines can reach it without comparing strings. A name read before it is
+// assigned in its procedimiento finds its slot unset at runtime and the
+// engines then fall back to looking it up by name in the enclosing scopes.
+class Resolver {
+private:
+  // declarations are collected before any read is resolved, so a read that
+  // comes before the assignment in the same procedimiento still finds it
+  enum class Pass { DECLARE, RESOLVE };
+
+  std::vector<ast::Scope *> scopes;
+  // mientras loops around the current statement in the current procedimiento
+  std::size_t loops = 0;
+
+  void walk(ast::ASTNode *node, Pass pass);
+  void walk_statements(const std::vector<ast::Statement *> &statements,
+                       Pass pass);
+  void resolve_name(ast::Identifier *name, Pass pass);
+  void resolve_function(ast::Function *function);
+  void resolve_identifier(ast::Identifier *identifier);
+  void resolve_return(ast::ReturnStatement *return_statement);
+
+public:
+  Resolver() = default;
+  // does nothing when the program was already resolved against globals
+  void resolve_program(ast::Program *program, ast::Scope &globals);
+};
+
+#endif // RESOLVER_H
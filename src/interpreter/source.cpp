@@ -0,0 +1,75 @@
+#include "source.h"
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <string_view>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define MIMIR_HAS_MMAP
+#endif
+
+SourceBuffer::~SourceBuffer()
+{
+#ifdef MIMIR_HAS_MMAP
+  if (mapping != nullptr) {
+    munmap(mapping, mapping_size);
+  }
+#endif
+}
+
+auto SourceBuffer::copy(std::string_view code) -> std::shared_ptr<SourceBuffer>
+{
+  auto buffer = std::shared_ptr<SourceBuffer>(new SourceBuffer());
+  buffer->owned = code;
+  buffer->text = buffer->owned;
+  return buffer;
+}
+
+auto SourceBuffer::borrow(std::string_view code)
+    -> std::shared_ptr<SourceBuffer>
+{
+  auto buffer = std::shared_ptr<SourceBuffer>(new SourceBuffer());
+  buffer->text = code;
+  return buffer;
+}
+
+auto SourceBuffer::map_file(const std::string &path)
+    -> std::shared_ptr<SourceBuffer>
+{
+#ifdef MIMIR_HAS_MMAP
+  const int descriptor = open(path.c_str(), O_RDONLY);
+  if (descriptor < 0) {
+    return nullptr;
+  }
+  struct stat info {};
+  if (fstat(descriptor, &info) == 0 && S_ISREG(info.st_mode) &&
+      info.st_size > 0) {
+    const auto size = static_cast<std::size_t>(info.st_size);
+    void *mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+    close(descriptor);
+    if (mapping == MAP_FAILED) {
+      return nullptr;
+    }
+    auto buffer = std::shared_ptr<SourceBuffer>(new SourceBuffer());
+    buffer->mapping = mapping;
+    buffer->mapping_size = size;
+    buffer->text = std::string_view(static_cast<const char *>(mapping), size);
+    return buffer;
+  }
+  // empty files and pipes can't be mapped, they are read like anywhere else
+  close(descriptor);
+#endif
+
+  std::ifstream file(path);
+  if (!file) {
+    return nullptr;
+  }
+  std::stringstream source;
+  source << file.rdbuf();
+  return copy(source.str());
+}
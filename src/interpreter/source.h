@@ -0,0 +1,36 @@
+#ifndef SOURCE_H
+#define SOURCE_H
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+
+// Text of a Mímir program. Tokens and AST nodes point into it instead of
+// copying their text, so whoever holds the nodes keeps the buffer alive.
+class SourceBuffer {
+  std::string owned;
+  std::string_view text;
+  void *mapping = nullptr;
+  std::size_t mapping_size = 0;
+
+  SourceBuffer() = default;
+
+public:
+  SourceBuffer(const SourceBuffer &) = delete;
+  auto operator=(const SourceBuffer &) -> SourceBuffer & = delete;
+  SourceBuffer(SourceBuffer &&) = delete;
+  auto operator=(SourceBuffer &&) -> SourceBuffer & = delete;
+  ~SourceBuffer();
+
+  static auto copy(std::string_view code) -> std::shared_ptr<SourceBuffer>;
+  // the caller keeps code alive for as long as the buffer is used
+  static auto borrow(std::string_view code) -> std::shared_ptr<SourceBuffer>;
+  // maps the file read-only where the platform allows it, otherwise reads it;
+  // nullptr when it can't be opened
+  static auto map_file(const std::string &path)
+      -> std::shared_ptr<SourceBuffer>;
+
+  [[nodiscard]] auto view() const -> std::string_view { return text; }
+};
+
+#endif // SOURCE_H
@@ -0,0 +1,57 @@
+#include "symbol.h"
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+struct NameHash {
+  using is_transparent = void;
+  auto operator()(std::string_view name) const noexcept -> std::size_t
+  {
+    return std::hash<std::string_view>{}(name);
+  }
+};
+
+// Owns the names, since the source a name was first read from may go away
+// before the last program that uses it.
+class SymbolTable {
+  std::unordered_map<std::string, Symbol, NameHash, std::equal_to<>> ids;
+  // views of the keys above, which never move
+  std::vector<std::string_view> names;
+
+public:
+  auto intern(std::string_view name) -> Symbol
+  {
+    auto itr = ids.find(name);
+    if (itr != ids.end()) {
+      return itr->second;
+    }
+    const auto symbol = static_cast<Symbol>(names.size());
+    itr = ids.emplace(std::string(name), symbol).first;
+    names.push_back(itr->first);
+    return symbol;
+  }
+
+  [[nodiscard]] auto name(Symbol symbol) const -> std::string_view
+  {
+    return names.at(symbol);
+  }
+};
+
+static auto table() -> SymbolTable &
+{
+  static SymbolTable symbols;
+  return symbols;
+}
+
+auto intern_symbol(std::string_view name) -> Symbol
+{
+  return table().intern(name);
+}
+
+auto symbol_name(Symbol symbol) -> std::string_view
+{
+  return table().name(symbol);
+}
@@ -0,0 +1,14 @@
+#ifndef SYMBOL_H
+#define SYMBOL_H
+#include <cstdint>
+#include <string_view>
+
+// Dense id standing for a name, so scopes and builtins compare names as
+// integers. Every distinct name gets its own id, shared by every program the
+// process runs.
+using Symbol = std::uint32_t;
+
+auto intern_symbol(std::string_view name) -> Symbol;
+auto symbol_name(Symbol symbol) -> std::string_view;
+
+#endif // SYMBOL_H
@@ -4,8 +4,10 @@
 #include "utils.h"
 #include <algorithm>
 #include <array>
+#include <cstddef>
 #include <ostream>
 #include <string>
+#include <string_view>
 
 enum class TokenType {
   ASSIGN,
@@ -72,9 +74,16 @@ static constexpr std::array<NameValuePair<TokenType>, 30> tokens_enums_strings{
      {TokenType::NOT_EQ, "NOT_EQ"},
      {TokenType::STRING, "STRING"}}};
 
+// for tables indexed by TokenType
+inline constexpr std::size_t TOKEN_TYPE_COUNT = tokens_enums_strings.size();
+static_assert(static_cast<std::size_t>(TokenType::STRING) + 1 ==
+              TOKEN_TYPE_COUNT);
+
+// the literal points into the SourceBuffer being lexed, or into a string
+// literal for the fixed operators, and is never copied
 class Token {
 public:
-  std::string literal;
+  std::string_view literal;
   TokenType token_type;
   int line;
 
@@ -82,10 +91,7 @@ public:
   Token(const TokenType tkn, const char *lit, const int line = 1,
         const std::size_t size = 1)
       : literal(lit, size), token_type(tkn), line(line) {}
-  Token(const TokenType tkn, const char *begin, const char *end,
-        const int line = 1)
-      : literal(begin, end), token_type(tkn), line(line) {}
-  Token(const TokenType tkn, const std::string &str, const int line = 1)
+  Token(const TokenType tkn, std::string_view str, const int line = 1)
       : literal(str), token_type(tkn), line(line) {}
   auto operator==(const Token &right) const noexcept -> bool
   {
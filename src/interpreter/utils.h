@@ -2,9 +2,15 @@
 #define UTILS_H
 #include <algorithm>
 #include <array>
+#include <bit>
 #include <cstdarg>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
 #include <string>
 #include <string_view>
+#include <type_traits>
+#include <utility>
 
 template <class T> struct NameValuePair {
   using value_type = T;
@@ -41,4 +47,81 @@ template <typename Key, typename Value, std::size_t Size> struct Map {
     return static_cast<bool>(itr != end(data));
   };
 };
+// Hashes for PerfectMap. Names are told apart by their length and their
+// first, middle and last characters, so nothing past those is read.
+constexpr auto perfect_hash(std::string_view key, std::uint32_t seed)
+    -> std::uint32_t
+{
+  constexpr std::uint32_t FNV_PRIME = 0x01000193U;
+  auto hash = (seed ^ static_cast<std::uint32_t>(key.size())) * FNV_PRIME;
+  if (!key.empty()) {
+    for (const auto chr : {key.front(), key[key.size() / 2], key.back()}) {
+      hash = (hash ^ static_cast<unsigned char>(chr)) * FNV_PRIME;
+    }
+  }
+  return hash ^ (hash >> 16U);
+}
+
+template <typename Enum>
+  requires std::is_enum_v<Enum>
+constexpr auto perfect_hash(Enum key, std::uint32_t seed) -> std::uint32_t
+{
+  constexpr std::uint32_t FNV_PRIME = 0x01000193U;
+  const auto hash = (seed ^ static_cast<std::uint32_t>(key)) * FNV_PRIME;
+  return hash ^ (hash >> 16U);
+}
+
+// Read-only map whose slots are laid out at compile time: the constructor
+// tries seeds until every key hashes to a slot of its own, so a lookup is one
+// hash and one comparison.
+template <typename Key, typename Value, std::size_t Size> class PerfectMap {
+  static constexpr std::size_t CAPACITY = std::bit_ceil(Size * 2);
+  static constexpr std::uint32_t MAX_SEED = 1U << 16U;
+
+  std::array<std::pair<Key, Value>, CAPACITY> slots{};
+  std::array<bool, CAPACITY> used{};
+  std::uint32_t seed = 0;
+
+  [[nodiscard]] constexpr auto slot(const Key &key) const -> std::size_t
+  {
+    return perfect_hash(key, seed) & (CAPACITY - 1);
+  }
+
+  constexpr auto place(const std::array<std::pair<Key, Value>, Size> &entries)
+      -> bool
+  {
+    used.fill(false);
+    for (const auto &entry : entries) {
+      const auto index = slot(entry.first);
+      if (used.at(index)) {
+        return false;
+      }
+      used.at(index) = true;
+      slots.at(index) = entry;
+    }
+    return true;
+  }
+
+public:
+  constexpr explicit PerfectMap(
+      const std::array<std::pair<Key, Value>, Size> &entries)
+  {
+    while (!place(entries)) {
+      if (++seed == MAX_SEED) {
+        throw std::logic_error("no perfect hash for the keys");
+      }
+    }
+  }
+
+  // nullptr when key isn't in the map
+  [[nodiscard]] constexpr auto find(const Key &key) const -> const Value *
+  {
+    const auto index = slot(key);
+    if (used[index] && slots[index].first == key) {
+      return &slots[index].second;
+    }
+    return nullptr;
+  }
+};
+
 #endif // UTILS_H
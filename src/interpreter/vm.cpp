@@ -0,0 +1,350 @@
+#include "vm.h"
+#include "builtin.h"
+#include "code.h"
+#include "evaluator.h"
+#include "gc.h"
+#include "object.h"
+#include "optimizer.h"
+#include "resolver.h"
+#include <cstddef>
+#include <cstdint>
+#include <fmt/format.h>
+#include <string>
+#include <vector>
+
+auto integer_binary_operation(OpCode opcode, std::int64_t left,
+                              std::int64_t right) -> obj::Value
+{
+  switch (opcode) {
+  case OpCode::ADD:
+    return obj::Value::make_integer(wrapping_add(left, right));
+  case OpCode::SUB:
+    return obj::Value::make_integer(wrapping_sub(left, right));
+  case OpCode::MUL:
+    return obj::Value::make_integer(wrapping_mul(left, right));
+  case OpCode::DIV:
+    return obj::Value::make_integer(wrapping_div(left, right));
+  case OpCode::EQ:
+    return left == right ? TRUE : FALSE;
+  case OpCode::NOT_EQ:
+    return left != right ? TRUE : FALSE;
+  case OpCode::LT:
+    return left < right ? TRUE : FALSE;
+  default:
+    return left > right ? TRUE : FALSE;
+  }
+}
+
+auto binary_operation(OpCode opcode, obj::Value left, obj::Value right,
+                      const int line) -> obj::Value
+{
+  // a division by zero goes the slow way to build its error
+  if (left.is_integer() && right.is_integer() &&
+      (opcode != OpCode::DIV || right.as_integer() != 0)) {
+    return integer_binary_operation(opcode, left.as_integer(),
+                                    right.as_integer());
+  }
+
+  static constexpr std::array<ast::Operator, 8> operators{
+      ast::Operator::PLUS, ast::Operator::MINUS, ast::Operator::MULTIPLICATION,
+      ast::Operator::DIVISION, ast::Operator::EQ, ast::Operator::NOT_EQ,
+      ast::Operator::LT, ast::Operator::GT};
+  const auto index = static_cast<std::size_t>(opcode) -
+                     static_cast<std::size_t>(OpCode::ADD);
+  return evaluate_infix_expression(operators.at(index), left, right, line);
+}
+
+VM::VM()
+    : max_depth(get_max_call_depth() == NO_CALL_DEPTH_LIMIT
+                    ? DEFAULT_VM_MAX_CALL_DEPTH
+                    : get_max_call_depth())
+{
+  heap.add_source(this);
+}
+
+auto VM::run(ast::Program *program, obj::Environment *env) -> obj::Value
+{
+  if (program->statements.empty()) {
+    return _NULL;
+  }
+
+  Optimizer optimizer;
+  optimizer.optimize_program(program);
+  Resolver resolver;
+  resolver.resolve_program(program, env->globals());
+  units.push_back(compiler.compile_program(program));
+  if (!compiler.errors().empty()) {
+    auto *error = heap.make<obj::Error>(compiler.errors().front());
+    compiler.errors().clear();
+    return obj::Value::make_object(error);
+  }
+
+  return execute(units.back()->main, env);
+}
+
+void trace_chunk(Heap &gc, const Chunk &chunk)
+{
+  for (const auto &constant : chunk.constants) {
+    gc.mark(constant);
+  }
+}
+
+void VM::trace_roots(Heap &gc) const
+{
+  for (const auto &value : stack) {
+    gc.mark(value);
+  }
+  for (const auto &frame : frames) {
+    gc.mark(frame.env);
+  }
+  for (const auto &unit : units) {
+    trace_chunk(gc, unit->main);
+    for (const auto &function : unit->functions) {
+      trace_chunk(gc, function->chunk);
+    }
+  }
+}
+
+auto VM::prototype(obj::Function *function) -> const FunctionProto *
+{
+  if (function->proto == nullptr) {
+    // functions created by the tree-walking evaluator are compiled on demand
+    if (units.empty()) {
+      units.push_back(std::make_unique<Bytecode>());
+    }
+    function->proto =
+        compiler.compile_function(*units.back(), function->parameters,
+                                  function->body, function->scope);
+  }
+  return function->proto;
+}
+
+void VM::call(std::size_t argc, const int line, const bool tail)
+{
+  const auto base = stack.size() - argc - 1;
+  auto callee = stack.at(base);
+
+  if (callee.type() == obj::ObjectType::FUNCTION) {
+    auto *function = static_cast<obj::Function *>(callee.as_object());
+    if (function->parameters.size() != argc) {
+      auto *error = heap.make<obj::Error>(
+          fmt::format(WRONG_ARGS, line, function->parameters.size(), argc));
+      stack.resize(base);
+      push(obj::Value::make_object(error));
+      return;
+    }
+    // the frame of the program itself doesn't count as a call
+    if (!tail && frames.size() > max_depth) {
+      auto *error =
+          heap.make<obj::Error>(fmt::format(STACK_OVERFLOW, line, max_depth));
+      stack.resize(base);
+      push(obj::Value::make_object(error));
+      return;
+    }
+
+    auto *env = tail ? frames.back().env : nullptr;
+    if (env != nullptr && env->reusable_for(function->env, function->scope)) {
+      env->reset();
+    }
+    else {
+      if (env != nullptr) {
+        heap.release_frame(env);
+      }
+      env = heap.make_frame(function->env, function->scope);
+    }
+    for (std::size_t i = 0; i < argc; i++) {
+      env->set_slot(function->parameters.at(i)->slot, stack.at(base + 1 + i));
+    }
+
+    if (tail) {
+      auto &frame = frames.back();
+      stack.resize(frame.base);
+      frame.chunk = &prototype(function)->chunk;
+      frame.ip = 0;
+      frame.env = env;
+    }
+    else {
+      stack.resize(base);
+      frames.push_back({&prototype(function)->chunk, 0, env, base,
+                        handlers.size()});
+    }
+    heap.safe_point();
+    return;
+  }
+
+  obj::Value result;
+  if (callee.type() == obj::ObjectType::BUILTIN) {
+    auto args = std::vector<obj::Value>(
+        stack.begin() + static_cast<std::ptrdiff_t>(base + 1), stack.end());
+    result = static_cast<obj::Builtin *>(callee.as_object())->fn(args, line);
+  }
+  else {
+    auto *error = heap.make<obj::Error>(
+        fmt::format(NOT_A_FUNCTION, callee.type_string(), line));
+    result = obj::Value::make_object(error);
+  }
+
+  stack.resize(base);
+  push(result);
+}
+
+auto VM::execute(const Chunk &chunk, obj::Environment *env) -> obj::Value
+{
+  const auto entry_depth = frames.size();
+  frames.push_back({&chunk, 0, env, stack.size(), handlers.size()});
+
+  // returns true when the outermost frame of this run has finished
+  auto unwind = [&](obj::Value value) -> bool {
+    auto &frame = frames.back();
+    if (handlers.size() > frame.handlers) {
+      // a regresa inside a mientras only ends the current iteration
+      stack.resize(handlers.back().stack_height);
+      frame.ip = handlers.back().target;
+      return false;
+    }
+
+    stack.resize(frame.base);
+    heap.release_frame(frame.env);
+    frames.pop_back();
+    push(value);
+    return frames.size() == entry_depth;
+  };
+
+  while (true) {
+    auto &frame = frames.back();
+    const auto &code = frame.chunk->code;
+    const auto op_offset = frame.ip;
+    const auto opcode = static_cast<OpCode>(code[frame.ip++]);
+
+    switch (opcode) {
+    case OpCode::CONSTANT:
+      push(frame.chunk->constants[frame.chunk->read_u16(frame.ip)]);
+      frame.ip += 2;
+      break;
+
+    case OpCode::NULL_VALUE:
+      push(_NULL);
+      break;
+
+    case OpCode::TRUE_VALUE:
+      push(TRUE);
+      break;
+
+    case OpCode::FALSE_VALUE:
+      push(FALSE);
+      break;
+
+    case OpCode::POP:
+      stack.pop_back();
+      break;
+
+    case OpCode::GET_SLOT: {
+      auto *scope_env = frame.env->ancestor(frame.chunk->read_u16(frame.ip));
+      auto value = scope_env->get_slot(frame.chunk->read_u16(frame.ip + 2));
+      if (value.is_unset()) {
+        const auto name = frame.chunk->read_u16(frame.ip + 4);
+        value = evaluate_identifier(frame.chunk->names[name],
+                                    scope_env->enclosing());
+      }
+      frame.ip += 6;
+      push(value);
+      break;
+    }
+
+    case OpCode::SET_SLOT:
+      frame.env->set_slot(frame.chunk->read_u16(frame.ip), stack.back());
+      frame.ip += 2;
+      break;
+
+    case OpCode::ADD:
+    case OpCode::SUB:
+    case OpCode::MUL:
+    case OpCode::DIV:
+    case OpCode::EQ:
+    case OpCode::NOT_EQ:
+    case OpCode::LT:
+    case OpCode::GT: {
+      auto right = pop();
+      auto left = pop();
+      push(binary_operation(opcode, left, right,
+                            frame.chunk->lines[op_offset]));
+      break;
+    }
+
+    case OpCode::MINUS: {
+      auto right = pop();
+      if (right.is_integer()) {
+        push(obj::Value::make_integer(wrapping_neg(right.as_integer())));
+      }
+      else {
+        push(evaluate_prefix_expression(ast::Operator::MINUS, right,
+                                        frame.chunk->lines[op_offset]));
+      }
+      break;
+    }
+
+    case OpCode::BANG: {
+      push(is_truthy(pop()) ? FALSE : TRUE);
+      break;
+    }
+
+    case OpCode::JUMP:
+      frame.ip = frame.chunk->read_u32(frame.ip);
+      break;
+
+    case OpCode::LOOP_BACK:
+      frame.chunk->loops[frame.chunk->read_u16(frame.ip + 4)]->back_edges++;
+      frame.ip = frame.chunk->read_u32(frame.ip);
+      heap.safe_point();
+      break;
+
+    case OpCode::JUMP_IF_FALSE: {
+      if (is_truthy(pop())) {
+        frame.ip += 4;
+      }
+      else {
+        frame.ip = frame.chunk->read_u32(frame.ip);
+      }
+      break;
+    }
+
+    case OpCode::LOOP_ENTER:
+      handlers.push_back({frame.ip, stack.size()});
+      break;
+
+    case OpCode::LOOP_EXIT:
+      handlers.pop_back();
+      break;
+
+    case OpCode::CHECK_ERROR:
+      if (stack.back().type() == obj::ObjectType::ERROR && unwind(pop())) {
+        return pop();
+      }
+      break;
+
+    case OpCode::CLOSURE: {
+      const auto *proto =
+          frame.chunk->functions[frame.chunk->read_u16(frame.ip)];
+      frame.ip += 2;
+      auto *func = heap.make<obj::Function>(proto->parameters, proto->body,
+                                            proto->scope, frame.env);
+      func->proto = proto;
+      push(obj::Value::make_object(func));
+      break;
+    }
+
+    case OpCode::CALL:
+    case OpCode::TAIL_CALL: {
+      const auto argc = static_cast<std::size_t>(code[frame.ip++]);
+      call(argc, frame.chunk->lines[op_offset], opcode == OpCode::TAIL_CALL);
+      break;
+    }
+
+    case OpCode::RETURN:
+      if (unwind(pop())) {
+        return pop();
+      }
+      break;
+    }
+  }
+}
@@ -0,0 +1,69 @@
+#ifndef VM_H
+#define VM_H
+#include "ast.h"
+#include "code.h"
+#include "compiler.h"
+#include "gc.h"
+#include "object.h"
+#include "utils.h"
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+enum class Engine { AST, VM, FLAT };
+
+// frames live in a vector rather than on the native stack, so this only
+// guards against runaway recursion eating all the memory
+inline constexpr std::size_t DEFAULT_VM_MAX_CALL_DEPTH = 1UL << 20UL;
+
+static constexpr std::array<NameValuePair<Engine>, 3> engines_enums_strings{
+    {{Engine::AST, "ast"}, {Engine::VM, "vm"}, {Engine::FLAT, "flat"}}};
+
+class VM : public RootSource {
+private:
+  struct Frame {
+    const Chunk *chunk;
+    std::size_t ip;
+    obj::Environment *env;
+    std::size_t base;
+    std::size_t handlers;
+  };
+
+  struct LoopHandler {
+    std::size_t target;
+    std::size_t stack_height;
+  };
+
+  std::vector<obj::Value> stack;
+  std::vector<Frame> frames;
+  std::vector<LoopHandler> handlers;
+  std::vector<std::unique_ptr<Bytecode>> units;
+  Compiler compiler;
+  std::size_t max_depth = DEFAULT_VM_MAX_CALL_DEPTH;
+
+  auto execute(const Chunk &chunk, obj::Environment *env) -> obj::Value;
+  void call(std::size_t argc, int line, bool tail);
+  auto prototype(obj::Function *function) -> const FunctionProto *;
+  void push(obj::Value value) { stack.push_back(value); }
+  auto pop() -> obj::Value
+  {
+    auto value = stack.back();
+    stack.pop_back();
+    return value;
+  }
+
+public:
+  VM();
+  VM(const VM &) = delete;
+  auto operator=(const VM &) -> VM & = delete;
+  VM(VM &&) = delete;
+  auto operator=(VM &&) -> VM & = delete;
+  ~VM() override { heap.remove_source(this); }
+  void set_max_depth(std::size_t depth) { max_depth = depth; }
+  auto run(ast::Program *program, obj::Environment *env) -> obj::Value;
+  void trace_roots(Heap &gc) const override;
+};
+
+#endif // VM_H
@@ -1,7 +1,9 @@
 #include "../src/interpreter/ast.h"
 #include "../src/interpreter/token.h"
 #include "catch2/catch_test_macros.hpp"
+#include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 using namespace std;
 using namespace ast;
@@ -11,10 +13,11 @@ TEST_CASE("Let statement", "[ast]")
   string let = "variable";
   string var1 = "mi_var";
   string var2 = "otra_var";
-  Program program(vector<Statement *>{
-      new LetStatement(Token(TokenType::LET, let),
-                       new Identifier(Token(TokenType::IDENT, var1), var1),
-                       new Identifier(Token(TokenType::IDENT, var2), var2))});
+  Arena arena;
+  Program program(vector<Statement *>{arena.make<LetStatement>(
+      Token(TokenType::LET, let),
+      arena.make<Identifier>(Token(TokenType::IDENT, var1), var1),
+      arena.make<Identifier>(Token(TokenType::IDENT, var2), var2))});
 
   string program_str = program.to_string();
 
@@ -25,9 +28,10 @@ TEST_CASE("Return statement", "[ast]")
 {
   string return_value = "regresa";
   string expression = "100";
-  Program program(vector<Statement *>{
-      new ReturnStatement(Token(TokenType::RETURN, return_value),
-                          new Expression(Token(TokenType::INT, expression)))});
+  Arena arena;
+  Program program(vector<Statement *>{arena.make<ReturnStatement>(
+      Token(TokenType::RETURN, return_value),
+      arena.make<Expression>(Token(TokenType::INT, expression)))});
 
   string program_str = program.to_string();
 
@@ -36,13 +40,14 @@ TEST_CASE("Return statement", "[ast]")
 
 TEST_CASE("Expression statement", "[ast]")
 {
+  Arena arena;
   Program program(vector<Statement *>{
-      new ExpressionStatement{
+      arena.make<ExpressionStatement>(
           Token(TokenType::IDENT, "foo", 1, 3),
-          new Identifier(Token(TokenType::IDENT, "foo", 1, 3), "foo")},
-      new ExpressionStatement{
+          arena.make<Identifier>(Token(TokenType::IDENT, "foo", 1, 3), "foo")),
+      arena.make<ExpressionStatement>(
           Token(TokenType::INT, "5"),
-          new Identifier(Token(TokenType::INT, "5"), "5")}});
+          arena.make<Identifier>(Token(TokenType::INT, "5"), "5"))});
 
   string program_str = program.to_string();
 
@@ -53,12 +58,45 @@ TEST_CASE("Assign statement", "[ast]")
 {
   string var = "a";
   string value = "mi_var";
-  Program program(vector<Statement *>{new AssignStatement(
+  Arena arena;
+  Program program(vector<Statement *>{arena.make<AssignStatement>(
       Token(TokenType::ASSIGN, "="),
-      new Identifier(Token(TokenType::IDENT, "a"), "a"),
-      new Expression(Token(TokenType::STRING, "mi_var", 1, 6)))});
+      arena.make<Identifier>(Token(TokenType::IDENT, "a"), "a"),
+      arena.make<Expression>(Token(TokenType::STRING, "mi_var", 1, 6)))});
 
   string program_str = program.to_string();
 
   REQUIRE(program_str == "a = mi_var");
 }
+
+TEST_CASE("Arena owns the nodes of a program", "[ast]")
+{
+  auto arena = make_unique<Arena>();
+  vector<string> names;
+  vector<Statement *> statements;
+  for (int i = 0; i < 5000; i++) {
+    const auto &name = names.emplace_back("n" + to_string(i));
+    statements.push_back(arena->make<ExpressionStatement>(
+        Token(TokenType::IDENT, name),
+        arena->make<Identifier>(Token(TokenType::IDENT, name), name)));
+  }
+  REQUIRE(arena->node_count() == 10000);
+
+  Program program(statements, std::move(arena));
+  REQUIRE(program.statements.back()->to_string() == "n4999");
+}
+
+TEST_CASE("Identifiers with the same name share a symbol", "[ast]")
+{
+  Arena arena;
+  const string copy = "contador";
+  auto *first =
+      arena.make<Identifier>(Token(TokenType::IDENT, "contador"), "contador");
+  auto *second = arena.make<Identifier>(Token(TokenType::IDENT, copy), copy);
+  auto *other =
+      arena.make<Identifier>(Token(TokenType::IDENT, "contadora"), "contadora");
+
+  REQUIRE(first->symbol == second->symbol);
+  REQUIRE(first->symbol != other->symbol);
+  REQUIRE(symbol_name(second->symbol) == "contador");
+}
@@ -1,8 +1,10 @@
 #include "../src/interpreter/ast.h"
+#include "../src/interpreter/builtin.h"
 #include "../src/interpreter/evaluator.h"
 #include "../src/interpreter/lexer.h"
 #include "../src/interpreter/object.h"
 #include "../src/interpreter/parser.h"
+#include "../src/interpreter/symbol.h"
 #include "catch2/catch_test_macros.hpp"
 #include <memory>
 #include <string>
@@ -10,16 +12,16 @@
 #include <vector>
 using namespace std;
 using ast::Program;
-using obj::Object;
 using obj::String;
+using obj::Value;
 
 auto evaluate_tests(const string &str, obj::Environment *env = nullptr)
-    -> Object *
+    -> Value
 {
   Lexer lexer(str);
   Parser parser(lexer);
   Program program(parser.parse_program());
-  Object *evaluated = nullptr;
+  Value evaluated;
   if (env == nullptr) {
     auto temp_env = make_unique<obj::Environment>();
     evaluated = evaluate(&program, temp_env.get());
@@ -28,30 +30,28 @@ auto evaluate_tests(const string &str, obj::Environment *env = nullptr)
     evaluated = evaluate(&program, env);
   }
 
-  REQUIRE(evaluated != nullptr);
-
   return evaluated;
 }
 
-void test_object(Object *evaluated, const int expected)
+void test_object(Value evaluated, const int expected)
 {
-  auto *eval = static_cast<obj::Integer *>(evaluated);
-  REQUIRE(eval->value == expected);
+  REQUIRE(evaluated.is_integer());
+  REQUIRE(evaluated.as_integer() == expected);
 }
 
-void test_object(Object *evaluated, const bool expected)
+void test_object(Value evaluated, const bool expected)
 {
-  auto *eval = static_cast<obj::Boolean *>(evaluated);
-  REQUIRE(eval->value == expected);
+  REQUIRE(evaluated.is_boolean());
+  REQUIRE(evaluated.as_boolean() == expected);
 }
 
-void test_object(Object *evaluated, const char *expected)
+void test_object(Value evaluated, const char *expected)
 {
-  auto *eval = static_cast<obj::Error *>(evaluated);
+  auto *eval = static_cast<obj::Error *>(evaluated.as_object());
   REQUIRE(eval->message == expected);
 }
 
-void test_object(const Object *evaluated) { REQUIRE(evaluated == _NULL.get()); }
+void test_object(Value evaluated) { REQUIRE(evaluated.is_null()); }
 
 template <typename T>
 void eval_and_test_objects(const vector<tuple<string, T>> &tests)
@@ -93,7 +93,7 @@ TEST_CASE("Null value", "[evaluator]")
                        "a = nulo; b = a; b"};
 
   for (const auto &exp : tests) {
-    auto *evaluated = evaluate_tests(exp);
+    auto evaluated = evaluate_tests(exp);
     test_object(evaluated);
   }
 }
@@ -109,6 +109,8 @@ TEST_CASE("Boolean evaluation", "[evaluator]")
                                     {"1 == 1", true},
                                     {"1 != 1", false},
                                     {"1 != 2", true},
+                                    {"-1 < 0", true},
+                                    {"5 - 10 < 0", true},
                                     {"verdadero == verdadero", true},
                                     {"falso == falso", true},
                                     {"verdadero == falso", false},
@@ -158,7 +160,7 @@ TEST_CASE("If else evaluation")
       {"si (1 > 2) { 10 } si_no { 20 }", &veinte}};
 
   for (auto &statement : tests) {
-    auto *evaluated = evaluate_tests(get<0>(statement));
+    auto evaluated = evaluate_tests(get<0>(statement));
 
     if (get<1>(statement) == nullptr) {
       test_object(evaluated);
@@ -187,6 +189,14 @@ TEST_CASE("Return evaluation")
                                     1}};
 
   eval_and_test_objects(tests);
+
+  // a regresa inside an operand leaves at once
+  test_object(evaluate_tests("variable f = procedimiento(x) {"
+                             "  variable y = 1 + si (x) { regresa 5; }"
+                             "                   si_no { 0 };"
+                             "  y };"
+                             "f(verdadero) + f(falso)"),
+              6);
 }
 
 TEST_CASE("Error handling")
@@ -225,6 +235,11 @@ TEST_CASE("Error handling")
        "Operador desconocido: STRING - STRING cerca de la línea 1"},
       {"longitud(1);", "Argumento para longitud sin soporte, se recibió "
                        "INTEGER cerca de la línea 1"},
+      {"longitud(longitud);", "Argumento para longitud sin soporte, se "
+                              "recibió BUILTIN cerca de la línea 1"},
+      {"longitud(procedimiento() {});", "Argumento para longitud sin "
+                                        "soporte, se recibió FUNCTION cerca "
+                                        "de la línea 1"},
       {R"(longitud("uno", "dos");)",
        "Número incorrecto de argumentos para longitud, se recibieron 2, se "
        "esperaba 1, cerca de la línea 1"}};
@@ -253,7 +268,7 @@ TEST_CASE("Assignment evaluation")
 
   auto env = make_unique<obj::Environment>();
   for (auto &test : tests) {
-    auto *evaluated = evaluate_tests(get<0>(test), env.get());
+    auto evaluated = evaluate_tests(get<0>(test), env.get());
     test_object(evaluated, get<1>(test));
   }
 }
@@ -266,9 +281,8 @@ TEST_CASE("Function evaluation")
   Program program(parser.parse_program());
 
   auto env = make_unique<obj::Environment>();
-  auto *evaluated = static_cast<obj::Function *>(evaluate(&program, env.get()));
-
-  REQUIRE(evaluated != nullptr);
+  auto *evaluated =
+      static_cast<obj::Function *>(evaluate(&program, env.get()).as_object());
 
   REQUIRE(evaluated->parameters.size() == 1);
   REQUIRE(evaluated->parameters.at(0)->to_string() == "x");
@@ -311,7 +325,7 @@ TEST_CASE("Function calls")
 
   auto env = make_unique<obj::Environment>();
   for (auto &test : tests) {
-    auto *evaluated = evaluate_tests(get<0>(test), env.get());
+    auto evaluated = evaluate_tests(get<0>(test), env.get());
     test_object(evaluated, get<1>(test));
   }
 }
@@ -332,8 +346,9 @@ TEST_CASE("String evaluation")
        "10 es mayor que 5"}};
 
   for (auto &test : tests) {
-    auto *evaluated = static_cast<String *>(evaluate_tests(get<0>(test)));
-    REQUIRE(evaluated->value == get<1>(test));
+    auto *evaluated =
+        static_cast<String *>(evaluate_tests(get<0>(test)).as_object());
+    REQUIRE(evaluated->value() == get<1>(test));
   }
 }
 
@@ -369,11 +384,20 @@ TEST_CASE("String concatenation")
        "foobar"},
       {"adios_str = procedimiento(){ regresa \"adios!\" };    \
             bye = adios_str(); bye",
-       "adios!"}};
+       "adios!"},
+      {"variable a = \"x\"; variable b = a + \"y\"; variable c = a + \"z\";"
+       "a + b + c + a",
+       "xxyxzx"},
+      {"variable a = \"ab\"; variable b = a + a; b + b", "abababab"},
+      {"variable s = \"\"; variable i = 0;"
+       "mientras (i < 3) { s = s + entero_a_cadena(i); i = i + 1; }"
+       "variable t = s; s = s + \"!\"; t + s",
+       "012012!"}};
 
   for (auto &test : tests) {
-    auto *evaluated = static_cast<String *>(evaluate_tests(get<0>(test)));
-    REQUIRE(evaluated->value == get<1>(test));
+    auto *evaluated =
+        static_cast<String *>(evaluate_tests(get<0>(test)).as_object());
+    REQUIRE(evaluated->value() == get<1>(test));
   }
 }
 
@@ -395,3 +419,192 @@ TEST_CASE("Builtin functions")
 
   eval_and_test_objects(tests);
 }
+
+TEST_CASE("Variable scopes")
+{
+  vector<tuple<string, int>> tests{
+      {"variable sumador = procedimiento(x) {"
+       "  procedimiento(y) { procedimiento(z) { x + y + z } } };"
+       "sumador(1)(2)(3)",
+       6},
+      {"variable x = 1;"
+       "variable f = procedimiento() { variable y = x; variable x = 5; y };"
+       "f()",
+       1},
+      {"variable x = 1;"
+       "variable f = procedimiento() { x = x + 1; x };"
+       "f() + x",
+       3},
+      {"variable f = procedimiento() { g() };"
+       "variable g = procedimiento() { 7 };"
+       "f()",
+       7},
+      {"variable i = 0; variable total = 0;"
+       "mientras (i < 3) { si (i > 0) { total = total + i }; i = i + 1; }"
+       "total",
+       3}};
+
+  eval_and_test_objects(tests);
+}
+
+TEST_CASE("Long loops")
+{
+  string str = "variable i = 0; mientras (i < 200000) { i = i + 1; } i";
+  Lexer lexer(str);
+  Parser parser(lexer);
+  Program program(parser.parse_program());
+  auto env = make_unique<obj::Environment>();
+
+  test_object(evaluate(&program, env.get()), 200000);
+  auto *loop = static_cast<ast::LoopStatement *>(program.statements.at(1));
+  REQUIRE(loop->back_edges == 200000);
+}
+
+TEST_CASE("Builtin lookups are cached per identifier")
+{
+  Lexer lexer("variable mide = procedimiento(s) { longitud(s) };"
+              "mide(\"abc\")");
+  Parser parser(lexer);
+  Program program(parser.parse_program());
+  auto env = make_unique<obj::Environment>();
+
+  test_object(evaluate(&program, env.get()), 3);
+  auto *let = static_cast<ast::LetStatement *>(program.statements.at(0));
+  auto *function = static_cast<ast::Function *>(let->value);
+  auto *statement =
+      static_cast<ast::ExpressionStatement *>(function->body->statements.at(0));
+  auto *callee = static_cast<ast::Identifier *>(
+      static_cast<ast::Call *>(statement->expression)->function);
+  REQUIRE(callee->builtin_cached);
+  // every translation unit finds the same builtin
+  REQUIRE(callee->builtin == find_builtin(intern_symbol("longitud")));
+
+  // a global of the same name hides the cached builtin
+  test_object(evaluate_tests("longitud = procedimiento(s) { 7 };"
+                             "mide(\"abc\")",
+                             env.get()),
+              7);
+}
+
+TEST_CASE("Inlined calls")
+{
+  vector<tuple<string, int>> tests{
+      {"variable doble = procedimiento(x) { x * 2 }; doble(21)", 42},
+      {"variable doble = procedimiento(x) { regresa x * 2; };"
+       "variable f = procedimiento(n) { regresa doble(n + 1); }; f(3)",
+       8},
+      {"variable mayor = procedimiento(a, b) { si (a > b) { a } si_no { b } };"
+       "variable i = 0; variable t = 0;"
+       "mientras (i < 10) { t = t + mayor(i, 5); i = i + 1; } t",
+       60}};
+  eval_and_test_objects(tests);
+
+  vector<tuple<string, const char *>> errors{
+      {"doble(1); variable doble = procedimiento(x) { x * 2 };",
+       "No es una function: NULL cerca de la línea 1"},
+      {"variable f = procedimiento(x) {\n x + verdadero }; f(1)",
+       "Discrepancia de tipos: INTEGER + BOOLEAN cerca de la línea 2"}};
+  eval_and_test_objects(errors);
+
+  // a later program may bind the name again, and its calls see that
+  auto env = make_unique<obj::Environment>();
+  Lexer lexer("variable doble = procedimiento(x) { x * 2 };"
+              "variable usa = procedimiento(y) { doble(y) }; usa(4)");
+  Parser parser(lexer);
+  Program program(parser.parse_program());
+  test_object(evaluate(&program, env.get()), 8);
+  test_object(
+      evaluate_tests("doble = procedimiento(x) { x + 1 }; usa(4)", env.get()),
+      5);
+}
+
+TEST_CASE("Infix nodes specialize on integer operands")
+{
+  Lexer lexer("variable suma = procedimiento(a, b) { variable c = a + b; c };"
+              "suma(1, 2)");
+  Parser parser(lexer);
+  Program program(parser.parse_program());
+  auto env = make_unique<obj::Environment>();
+
+  test_object(evaluate(&program, env.get()), 3);
+  auto *let = static_cast<ast::LetStatement *>(program.statements.at(0));
+  auto *function = static_cast<ast::Function *>(let->value);
+  auto *inner =
+      static_cast<ast::LetStatement *>(function->body->statements.at(0));
+  auto *infix = static_cast<ast::Infix *>(inner->value);
+  REQUIRE(infix->state == ast::InfixState::INTEGER_PLUS);
+  test_object(evaluate_tests("suma(5, 6)", env.get()), 11);
+
+  // a guard that fails sends it back to the generic path for good
+  auto *joined = static_cast<String *>(
+      evaluate_tests("suma(\"a\", \"b\")", env.get()).as_object());
+  REQUIRE(joined->value() == "ab");
+  REQUIRE(infix->state == ast::InfixState::GENERIC);
+  test_object(evaluate_tests("suma(5, 6)", env.get()), 11);
+  test_object(evaluate_tests("suma(5, verdadero)", env.get()),
+              "Discrepancia de tipos: INTEGER + BOOLEAN cerca de la línea 1");
+}
+
+TEST_CASE("Call depth limit")
+{
+  const string countdown =
+      "variable f = procedimiento(n) {"
+      "  si (n == 0) { regresa 0; } regresa 1 + f(n - 1); };";
+  test_object(evaluate_tests(countdown + "f(400)"), 400);
+
+  // deeper than the 500 calls the evaluator used to stop at, on a stack as
+  // big as the interpreter's; the string keeps the calls away from the JIT
+  Value deep;
+  Value deeper;
+  run_with_stack(INTERPRETER_STACK, [&deep, &deeper] {
+    deep = evaluate_tests("variable suma = procedimiento(n) {"
+                          "  si (n == 0) { 0 } si_no { n + suma(n - 1) } };"
+                          "suma(600)");
+    deeper = evaluate_tests("variable suma = procedimiento(n, s) {"
+                            "  si (n == 0) { 0 } si_no {"
+                            "    n + suma(n - 1, s) } };"
+                            "suma(10000, \"x\")");
+  });
+  test_object(deep, 180300);
+  test_object(deeper, 50005000);
+
+  // the overflow reaches the program through the + waiting on each call
+  const string forever =
+      "variable f = procedimiento(n, s) { n + f(n + 1, s) }; f(0, \"x\")";
+  auto evaluated = evaluate_tests(forever);
+  REQUIRE(evaluated.type() == obj::ObjectType::ERROR);
+  REQUIRE(static_cast<obj::Error *>(evaluated.as_object())
+              ->message.starts_with(
+                  "Desbordamiento de pila cerca de la línea 1, se superaron "));
+
+  set_max_call_depth(10);
+  test_object(evaluate_tests(countdown + "f(9)"), 9);
+  test_object(evaluate_tests(forever),
+              "Desbordamiento de pila cerca de la línea 1, se superaron 10 "
+              "llamadas anidadas");
+  set_max_call_depth(NO_CALL_DEPTH_LIMIT);
+}
+
+TEST_CASE("Tail calls")
+{
+  vector<tuple<string, int>> tests{
+      {"variable ciclo = procedimiento(n, acc) {"
+       "  si (n == 0) { regresa acc; } regresa ciclo(n - 1, acc + 2); };"
+       "ciclo(100000, 0)",
+       200000},
+      {"variable par = procedimiento(n) {"
+       "  si (n == 0) { regresa 1; } regresa impar(n - 1); };"
+       "variable impar = procedimiento(n) {"
+       "  si (n == 0) { regresa 0; } regresa par(n - 1); };"
+       "par(10001)",
+       0},
+      {"variable f = procedimiento(n, g) {"
+       "  si (n == 0) { regresa g(); }"
+       "  regresa f(n - 1, procedimiento() { n }); };"
+       "f(3, procedimiento() { 0 })",
+       1},
+      {"variable f = procedimiento(n) { regresa longitud(\"abc\"); }; f(1)",
+       3}};
+
+  eval_and_test_objects(tests);
+}
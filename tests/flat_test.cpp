@@ -0,0 +1,160 @@
+#include "../src/interpreter/ast.h"
+#include "../src/interpreter/evaluator.h"
+#include "../src/interpreter/flat.h"
+#include "../src/interpreter/lexer.h"
+#include "../src/interpreter/object.h"
+#include "../src/interpreter/parser.h"
+#include "catch2/catch_test_macros.hpp"
+#include <memory>
+#include <string>
+#include <vector>
+using namespace std;
+using ast::Program;
+using obj::Value;
+
+auto run_flat(const string &str) -> Value
+{
+  Lexer lexer(str);
+  Parser parser(lexer);
+  Program program(parser.parse_program());
+  REQUIRE(parser.errors().empty());
+
+  FlatEvaluator flat;
+  auto env = make_unique<obj::Environment>();
+  return flat.run(&program, env.get());
+}
+
+auto run_ast(const string &str) -> string
+{
+  Lexer lexer(str);
+  Parser parser(lexer);
+  Program program(parser.parse_program());
+  auto env = make_unique<obj::Environment>();
+  return evaluate(&program, env.get()).inspect();
+}
+
+TEST_CASE("Flat evaluator matches the tree-walking evaluator", "[flat]")
+{
+  vector<string> tests{
+      "2 * (5 - 3) + 50 / 2",
+      "si (1 > 2) { 10 }",
+      "si (1 < 2) { 10 } si_no { 20 }",
+      "9; regresa 3 * 6; 9;",
+      "!!nulo",
+      "5 + verdadero; 9;",
+      "-verdadero",
+      "si (10 > 7) {\n regresa verdadero + falso;\n }",
+      "longitud(1);",
+      "variable f = procedimiento(x) { x }; f(1, 2)",
+      "variable a = 5; a(1)",
+      "variable x = 1;"
+      "variable f = procedimiento() { variable y = x; variable x = 5; y };"
+      "f()",
+      "variable f = procedimiento() { g() };"
+      "variable g = procedimiento() { 7 }; f()",
+      "variable f = procedimiento() { regresa g(1); };"
+      "variable g = procedimiento(x, y) { x }; f()",
+      "variable x = 7;\n x / (3 - 3)",
+      "variable i = 0; mientras (i < 10) { i = i + 1; regresa 5; } i",
+      "variable f = procedimiento(x) {"
+      "  variable y = 1 + si (x) { regresa 5; } si_no { 0 }; y };"
+      "f(verdadero) + f(falso)",
+      "variable suma = procedimiento(a) { procedimiento(b) { a + b } };"
+      "suma(2)(3)",
+      R"(variable fibonacci = procedimiento(numero) {
+           variable a = 0;
+           variable b = 1;
+           variable c = 1;
+           variable secuencia = "";
+           variable contador = 1;
+           mientras (contador < numero) {
+             c = a + b;
+             secuencia = secuencia + entero_a_cadena(c) + " ";
+             a = b;
+             b = c;
+             contador = contador + 1;
+           }
+           regresa secuencia;
+         }
+         fibonacci(15);)"};
+
+  for (auto &test : tests) {
+    INFO(test);
+    REQUIRE(run_flat(test).inspect() == run_ast(test));
+  }
+}
+
+TEST_CASE("Flat evaluator keeps the environment between runs", "[flat]")
+{
+  auto env = make_unique<obj::Environment>();
+  FlatEvaluator flat;
+  vector<unique_ptr<Program>> programs;
+  for (const string code :
+       {"variable doble = procedimiento(x) { x * 2 };", "doble(10)"}) {
+    Lexer lexer(code);
+    Parser parser(lexer);
+    auto statements = parser.parse_program();
+    programs.push_back(
+        make_unique<Program>(statements, parser.take_arena()));
+  }
+
+  flat.run(programs.at(0).get(), env.get());
+  REQUIRE(flat.run(programs.at(1).get(), env.get()).inspect() == "20");
+}
+
+TEST_CASE("Flat evaluator tail calls and call depth", "[flat]")
+{
+  Lexer lexer("variable ciclo = procedimiento(n, acc) {"
+              "  si (n == 0) { regresa acc; }"
+              "  regresa ciclo(n - 1, acc + 2); };"
+              "ciclo(100000, 0)");
+  Parser parser(lexer);
+  Program program(parser.parse_program());
+  auto env = make_unique<obj::Environment>();
+  FlatEvaluator flat;
+  flat.set_max_depth(10);
+  REQUIRE(flat.run(&program, env.get()).inspect() == "200000");
+
+  string deep;
+  run_with_stack(INTERPRETER_STACK, [&deep] {
+    deep = run_flat("variable suma = procedimiento(n, s) {"
+                    "  si (n == 0) { 0 } si_no { n + suma(n - 1, s) } };"
+                    "suma(600, \"x\")")
+               .inspect();
+  });
+  REQUIRE(deep == "180300");
+
+  const string forever =
+      "variable f = procedimiento(n) { n + f(n + 1) }; f(0)";
+  auto evaluated = run_flat(forever);
+  REQUIRE(evaluated.type() == obj::ObjectType::ERROR);
+  REQUIRE(static_cast<obj::Error *>(evaluated.as_object())
+              ->message.starts_with(
+                  "Desbordamiento de pila cerca de la línea 1, se superaron "));
+
+  Lexer forever_lexer(forever);
+  Parser forever_parser(forever_lexer);
+  Program forever_program(forever_parser.parse_program());
+  auto forever_env = make_unique<obj::Environment>();
+  FlatEvaluator limited;
+  limited.set_max_depth(20);
+  evaluated = limited.run(&forever_program, forever_env.get());
+  REQUIRE(evaluated.type() == obj::ObjectType::ERROR);
+  REQUIRE(static_cast<obj::Error *>(evaluated.as_object())->message ==
+          "Desbordamiento de pila cerca de la línea 1, se superaron 20 "
+          "llamadas anidadas");
+}
+
+TEST_CASE("Flat nodes take one entry each", "[flat]")
+{
+  Lexer lexer("variable x = 1 + 2 * y; si (x > 3) { x } si_no { f(x, 4) }");
+  Parser parser(lexer);
+  Program program(parser.parse_program());
+  auto env = make_unique<obj::Environment>();
+  FlatEvaluator flat;
+  flat.run(&program, env.get());
+
+  // the let, +, 1, *, 2, y; the si, >, x, 3, two blocks, x, the call, f, x
+  // and 4; and the program's block
+  REQUIRE(flat.flat_tree().node_count() == 18);
+}
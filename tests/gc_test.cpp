@@ -0,0 +1,165 @@
+#include "../src/interpreter/ast.h"
+#include "../src/interpreter/evaluator.h"
+#include "../src/interpreter/flat.h"
+#include "../src/interpreter/gc.h"
+#include "../src/interpreter/lexer.h"
+#include "../src/interpreter/object.h"
+#include "../src/interpreter/parser.h"
+#include "../src/interpreter/vm.h"
+#include "catch2/catch_test_macros.hpp"
+#include <memory>
+#include <string>
+#include <tuple>
+#include <vector>
+using namespace std;
+using ast::Program;
+
+auto run_collecting(const string &str, Engine engine) -> string
+{
+  Lexer lexer(str);
+  Parser parser(lexer);
+  Program program(parser.parse_program());
+  REQUIRE(parser.errors().empty());
+
+  // collect at every safe point so a missing root shows up right away
+  heap.set_threshold(0);
+  auto env = make_unique<obj::Environment>();
+  string result;
+  if (engine == Engine::VM) {
+    VM machine;
+    result = machine.run(&program, env.get()).inspect();
+  }
+  else if (engine == Engine::FLAT) {
+    FlatEvaluator flat;
+    result = flat.run(&program, env.get()).inspect();
+  }
+  else {
+    result = evaluate(&program, env.get()).inspect();
+  }
+  heap.set_threshold(DEFAULT_GC_THRESHOLD);
+
+  return result;
+}
+
+TEST_CASE("Garbage is collected inside long loops", "[gc]")
+{
+  const string code = "variable i = 0; variable s = \"\"; variable a = \"a\";"
+                      "mientras (i < 2000) { s = a + \"b\"; i = i + 1; } "
+                      "s";
+
+  for (auto engine : {Engine::AST, Engine::VM, Engine::FLAT}) {
+    heap.collect();
+    const auto before = heap.object_count();
+    REQUIRE(run_collecting(code, engine) == "ab");
+    REQUIRE(heap.object_count() < before + 100);
+  }
+}
+
+TEST_CASE("String literals are interned", "[gc]")
+{
+  Lexer lexer("variable i = 0; variable s = \"\";"
+              "mientras (i < 2000) { s = \"abc\"; i = i + 1; } s");
+  Parser parser(lexer);
+  Program program(parser.parse_program());
+  auto env = make_unique<obj::Environment>();
+
+  heap.collect();
+  const auto before = heap.object_count();
+  auto evaluated = evaluate(&program, env.get());
+  REQUIRE(evaluated.inspect() == "abc");
+  REQUIRE(heap.object_count() < before + 10);
+
+  VM machine;
+  REQUIRE(machine.run(&program, env.get()).as_object() ==
+          evaluated.as_object());
+  REQUIRE(heap.intern("abc") == evaluated.as_object());
+}
+
+TEST_CASE("Live values survive collections", "[gc]")
+{
+  vector<tuple<string, string>> tests{
+      {"variable sumador = procedimiento(x) { procedimiento(y) { x + y } };"
+       "variable suma_dos = sumador(2);"
+       "variable i = 0; mientras (i < 50) { i = i + 1; } "
+       "suma_dos(3)",
+       "5"},
+      {"variable f = procedimiento() {"
+       "  variable i = 0; mientras (i < 20) { i = i + 1; } \"b\" };"
+       "\"a\" + f()",
+       "ab"},
+      {"variable f = procedimiento() {"
+       "  variable i = 0; mientras (i < 20) { i = i + 1; } \"c\" };"
+       "variable g = procedimiento(a, b) { a + b };"
+       "g(\"a\" + \"b\", f())",
+       "abc"},
+      {"variable fib = procedimiento(n) {"
+       "  si (n < 2) { regresa n; };"
+       "  regresa fib(n - 1) + fib(n - 2); };"
+       "fib(15)",
+       "610"},
+      {"variable doble = procedimiento(n) { n * 2 };"
+       "variable guarda = procedimiento(n) {"
+       "  variable x = doble(n); procedimiento() { x } };"
+       "variable a = guarda(1); variable b = guarda(2); a() + b()",
+       "6"},
+  };
+
+  for (const auto &test : tests) {
+    INFO(get<0>(test));
+    REQUIRE(run_collecting(get<0>(test), Engine::AST) == get<1>(test));
+    REQUIRE(run_collecting(get<0>(test), Engine::VM) == get<1>(test));
+    REQUIRE(run_collecting(get<0>(test), Engine::FLAT) == get<1>(test));
+  }
+}
+
+TEST_CASE("Calls that create no procedimiento recycle their frames", "[gc]")
+{
+  // the string argument keeps the calls away from the JIT
+  Lexer lexer("variable f = procedimiento(n, s) {"
+              "  si (n < 2) { regresa n; } f(n - 1, s) + f(n - 2, s) };"
+              "f(15, \"x\")");
+  Parser parser(lexer);
+  Program program(parser.parse_program());
+  auto env = make_unique<obj::Environment>();
+
+  for (auto engine : {Engine::AST, Engine::VM, Engine::FLAT}) {
+    heap.collect();
+    const auto before = heap.object_count();
+    string result;
+    if (engine == Engine::VM) {
+      VM machine;
+      result = machine.run(&program, env.get()).inspect();
+    }
+    else if (engine == Engine::FLAT) {
+      FlatEvaluator flat;
+      result = flat.run(&program, env.get()).inspect();
+    }
+    else {
+      result = evaluate(&program, env.get()).inspect();
+    }
+    REQUIRE(result == "610");
+    REQUIRE(heap.object_count() < before + 10);
+  }
+}
+
+TEST_CASE("Literals don't grow when used as accumulators", "[gc]")
+{
+  Lexer lexer("variable i = 0; variable s = \"\";"
+              "mientras (i < 1000) { s = s + \"ab\"; i = i + 1; } s");
+  Parser parser(lexer);
+  Program program(parser.parse_program());
+  auto env = make_unique<obj::Environment>();
+
+  heap.collect();
+  const auto before = heap.allocated_bytes();
+  auto evaluated = evaluate(&program, env.get());
+  REQUIRE(evaluated.type() == obj::ObjectType::STRING);
+  REQUIRE(static_cast<obj::String *>(evaluated.as_object())->value().size() ==
+          2000);
+  // the buffer the concatenations built counts as allocated
+  REQUIRE(heap.allocated_bytes() >= before + 2000);
+  // the literal's own buffer was copied rather than appended to
+  REQUIRE(heap.intern("")->value().empty());
+  REQUIRE(static_cast<obj::String *>(evaluated.as_object())->value().data() !=
+          heap.intern("")->value().data());
+}
@@ -0,0 +1,107 @@
+#include "../src/interpreter/ast.h"
+#include "../src/interpreter/evaluator.h"
+#include "../src/interpreter/jit.h"
+#include "../src/interpreter/lexer.h"
+#include "../src/interpreter/object.h"
+#include "../src/interpreter/parser.h"
+#include "../src/interpreter/symbol.h"
+#include "catch2/catch_test_macros.hpp"
+#include <memory>
+#include <string>
+#include <vector>
+using namespace std;
+using ast::Program;
+using obj::Value;
+
+auto run_with_threshold(const string &str, size_t threshold) -> string
+{
+  Lexer lexer(str);
+  Parser parser(lexer);
+  Program program(parser.parse_program());
+  REQUIRE(parser.errors().empty());
+  set_jit_threshold(threshold);
+  auto env = make_unique<obj::Environment>();
+  auto result = evaluate(&program, env.get()).inspect();
+  set_jit_threshold(DEFAULT_JIT_THRESHOLD);
+  return result;
+}
+
+TEST_CASE("Native code matches the evaluator", "[jit]")
+{
+  vector<string> tests{
+      "variable factorial = procedimiento(n) {"
+      "  si (n < 2) { regresa 1; } n * factorial(n - 1) };"
+      "factorial(20)",
+      "variable fib = procedimiento(n) {"
+      "  si (n < 2) { n } si_no { fib(n - 1) + fib(n - 2) } };"
+      "fib(20)",
+      "variable mcd = procedimiento(a, b) {"
+      "  si (b == 0) { regresa a; } regresa mcd(b, a - a / b * b); };"
+      "mcd(1071, 462) + mcd(17, 5)",
+      "variable suma = procedimiento(n) {"
+      "  variable total = 0; variable i = 0;"
+      "  mientras (i < n) { i = i + 1; si (i > 5) { regresa 0; }"
+      "    total = total + i; }"
+      "  total };"
+      "suma(10) + suma(3)",
+      "variable par = procedimiento(n) { si (n == 0) { verdadero } si_no {"
+      "  !(n / 2 * 2 != n) } };"
+      "par(4) == par(7)",
+      "variable nada = procedimiento(x) { si (x > 0) { nulo } }; nada(3)",
+      "variable cuenta = procedimiento(n, acc) {"
+      "  si (n == 0) { regresa acc; } regresa cuenta(n - 1, acc + 1); };"
+      "cuenta(100000, 0)",
+      "variable g = procedimiento(x) { x / -1 + -x };"
+      "g(1073741824 * 1073741824 * 8)",
+      "variable d = procedimiento(x, y) { x / y }; d(7, 2); d(7, 0)",
+      "variable d = procedimiento(x) { 5 + verdadero }; d(1)",
+      "variable f = procedimiento(n) { si (n == 0) { 0 } si_no { f(n - 1) } };"
+      "f(600)",
+      "variable y = 3; variable f = procedimiento(x) { x + y }; f(1)",
+      "variable f = procedimiento(x) { x }; f(verdadero); f(2)"};
+
+  for (auto &test : tests) {
+    INFO(test);
+    REQUIRE(run_with_threshold(test, 1) == run_with_threshold(test, 0));
+  }
+}
+
+TEST_CASE("Hot procedimientos get native code", "[jit]")
+{
+  Lexer lexer("variable fib = procedimiento(n) {"
+              "  si (n < 2) { n } si_no { fib(n - 1) + fib(n - 2) } };"
+              "variable saluda = procedimiento(n) { \"hola\" };"
+              "fib(10); saluda(1); saluda(2);");
+  Parser parser(lexer);
+  Program program(parser.parse_program());
+  set_jit_threshold(2);
+  auto env = make_unique<obj::Environment>();
+  evaluate(&program, env.get());
+  set_jit_threshold(DEFAULT_JIT_THRESHOLD);
+
+  auto fib = env->lookup(intern_symbol("fib"));
+  auto saluda = env->lookup(intern_symbol("saluda"));
+  REQUIRE(fib.type() == obj::ObjectType::FUNCTION);
+  REQUIRE(saluda.type() == obj::ObjectType::FUNCTION);
+#ifdef MIMIR_HAS_JIT
+  REQUIRE(has_native_code(static_cast<obj::Function *>(fib.as_object())));
+#endif
+  // strings are left to the evaluator
+  REQUIRE_FALSE(
+      has_native_code(static_cast<obj::Function *>(saluda.as_object())));
+}
+
+TEST_CASE("Native calls stop before the stack runs out", "[jit]")
+{
+  // frames with many slots run out of stack long before any call count
+  string locals;
+  for (int i = 0; i < 80; i++) {
+    locals += "variable v" + to_string(i) + " = n + " + to_string(i) + "; ";
+  }
+  const auto evaluated = run_with_threshold(
+      "variable f = procedimiento(n) { " + locals +
+          "si (n == 0) { 0 } si_no { v1 - n + f(n - 1) } };"
+          "variable i = 0; mientras (i < 200) { f(3); i = i + 1; } f(16000)",
+      DEFAULT_JIT_THRESHOLD);
+  REQUIRE(evaluated.starts_with("Desbordamiento de pila cerca de la línea 1"));
+}
@@ -1,4 +1,5 @@
 #include "../src/interpreter/lexer.h"
+#include "../src/interpreter/source.h"
 #include "../src/interpreter/token.h"
 #include "catch2/catch_test_macros.hpp"
 #include <string>
@@ -237,3 +238,63 @@ TEST_CASE("String")
 
   REQUIRE(tokens == expected_tokens);
 }
+
+TEST_CASE("Tokens point into the source buffer", "[lexer]")
+{
+  string str = "variable nombre = \"Mímir\"; 42";
+  auto source = SourceBuffer::borrow(str);
+  Lexer lexer(source);
+
+  const auto *begin = str.data();
+  const auto *end = str.data() + str.size();
+  for (auto token = lexer.next_token(); token.token_type != TokenType::_EOF;
+       token = lexer.next_token()) {
+    INFO(token.literal);
+    REQUIRE(token.literal.data() >= begin);
+    REQUIRE(token.literal.data() + token.literal.size() <= end);
+  }
+}
+
+TEST_CASE("Long runs and UTF-8 identifiers", "[lexer]")
+{
+  string str = "variable año_de_nacimiento_del_usuario = 1234567890123456789;"
+               "\n\n   \t\r\n                    \n  señal";
+  Lexer lexer(str);
+  vector<Token> tokens;
+  for (size_t i = 0; i < 6; i++) {
+    tokens.push_back(lexer.next_token());
+  }
+
+  vector<Token> expected_tokens{
+      Token(TokenType::LET, "variable", 1, 8),
+      Token(TokenType::IDENT, "año_de_nacimiento_del_usuario"sv),
+      Token(TokenType::ASSIGN, "="),
+      Token(TokenType::INT, "1234567890123456789"sv),
+      Token(TokenType::SEMICOLON, ";"),
+      Token(TokenType::IDENT, "señal"sv)};
+
+  REQUIRE(tokens == expected_tokens);
+  REQUIRE(tokens.back().line == 5);
+  REQUIRE(lexer.next_token().token_type == TokenType::_EOF);
+}
+
+TEST_CASE("Keywords and names close to them", "[lexer]")
+{
+  string src = "nulo mientras si_n variables Si regresar falsos nul";
+  Lexer lexer(src);
+  vector<Token> tokens;
+  for (size_t i = 0; i < 8; i++) {
+    tokens.push_back(lexer.next_token());
+  }
+
+  vector<Token> expected_tokens{Token(TokenType::_NULL, "nulo", 1, 4),
+                                Token(TokenType::LOOP, "mientras", 1, 8),
+                                Token(TokenType::IDENT, "si_n", 1, 4),
+                                Token(TokenType::IDENT, "variables", 1, 9),
+                                Token(TokenType::IDENT, "Si", 1, 2),
+                                Token(TokenType::IDENT, "regresar", 1, 8),
+                                Token(TokenType::IDENT, "falsos", 1, 6),
+                                Token(TokenType::IDENT, "nul", 1, 3)};
+
+  REQUIRE(tokens == expected_tokens);
+}
@@ -0,0 +1,166 @@
+#include "../src/interpreter/ast.h"
+#include "../src/interpreter/evaluator.h"
+#include "../src/interpreter/lexer.h"
+#include "../src/interpreter/object.h"
+#include "../src/interpreter/optimizer.h"
+#include "../src/interpreter/parser.h"
+#include "catch2/catch_test_macros.hpp"
+#include <memory>
+#include <string>
+#include <tuple>
+#include <vector>
+using namespace std;
+using namespace ast;
+
+auto optimized(const string &code) -> unique_ptr<Program>
+{
+  Lexer lexer(code);
+  Parser parser(lexer);
+  auto statements = parser.parse_program();
+  REQUIRE(parser.errors().empty());
+  auto program = make_unique<Program>(statements, parser.take_arena());
+  Optimizer optimizer;
+  optimizer.optimize_program(program.get());
+  return program;
+}
+
+auto last_expression(Program &program) -> Expression *
+{
+  auto *statement = program.statements.back();
+  REQUIRE(statement->type() == Node::ExpressionStatement);
+  return static_cast<ExpressionStatement *>(statement)->expression;
+}
+
+TEST_CASE("Operators over literals are folded", "[optimizer]")
+{
+  vector<tuple<string, Node, string>> tests{
+      {"2 * 60 * 60", Node::Integer, "7200"},
+      {"-5 + 2", Node::Integer, to_string(static_cast<size_t>(-3))},
+      {R"("Hola " + "Mundo!")", Node::StringLiteral, "Hola Mundo!"},
+      {"!verdadero", Node::Boolean, "falso"},
+      {"(1 < 2) == verdadero", Node::Boolean, "verdadero"},
+      {R"("a" != "b")", Node::Boolean, "verdadero"},
+      {"nulo == nulo", Node::Boolean, "verdadero"}};
+
+  for (auto &test : tests) {
+    INFO(get<0>(test));
+    auto program = optimized(get<0>(test));
+    auto *expression = last_expression(*program);
+    REQUIRE(expression->type() == get<1>(test));
+    REQUIRE(expression->to_string() == get<2>(test));
+  }
+}
+
+TEST_CASE("Only literal operands are folded", "[optimizer]")
+{
+  vector<string> tests{"variable x = 1; x * 1", "variable x = 1; x + 2 * 3",
+                       R"("a" + 1)", "10 / 0", "-verdadero"};
+
+  for (auto &test : tests) {
+    INFO(test);
+    auto program = optimized(test);
+    auto type = last_expression(*program)->type();
+    REQUIRE((type == Node::Infix || type == Node::Prefix));
+  }
+
+  auto program = optimized("variable x = 1; x + 2 * 3");
+  auto *infix = static_cast<Infix *>(last_expression(*program));
+  REQUIRE(infix->right->type() == Node::Integer);
+  REQUIRE(infix->right->to_string() == "6");
+}
+
+TEST_CASE("Failing operations keep their line", "[optimizer]")
+{
+  vector<tuple<string, string>> tests{
+      {"variable x = 1;\n10 / (5 - 5)",
+       "División entre cero: 10 / 0 cerca de la línea 2"},
+      {"variable x = 1;\n\n\"a\" + (1 + 1)",
+       "Discrepancia de tipos: STRING + INTEGER cerca de la línea 3"}};
+
+  for (auto &test : tests) {
+    INFO(get<0>(test));
+    auto program = optimized(get<0>(test));
+    auto env = make_unique<obj::Environment>();
+    auto evaluated = evaluate(program.get(), env.get());
+    REQUIRE(evaluated.type() == obj::ObjectType::ERROR);
+    REQUIRE(static_cast<obj::Error *>(evaluated.as_object())->message ==
+            get<1>(test));
+  }
+}
+
+TEST_CASE("Literal si conditions keep only the branch taken", "[optimizer]")
+{
+  auto program = optimized("si (1 > 2) { 10 } si_no { 20 }");
+  REQUIRE(program->statements.back()->type() == Node::Block);
+  REQUIRE(program->statements.back()->to_string() == "20");
+
+  program = optimized("si (falso) { 10 }");
+  REQUIRE(last_expression(*program)->type() == Node::Null);
+
+  program = optimized("variable x = si (\"\") { 1 } si_no { 2 }");
+  auto *let_statement = static_cast<LetStatement *>(program->statements.back());
+  auto *if_expression = static_cast<If *>(let_statement->value);
+  REQUIRE(if_expression->type() == Node::If);
+  REQUIRE(if_expression->alternative == nullptr);
+  REQUIRE(if_expression->consequence->to_string() == "1");
+
+  program = optimized("variable x = 5; si (x > 2) { 10 }");
+  REQUIRE(last_expression(*program)->type() == Node::If);
+}
+
+TEST_CASE("Procedimiento bodies are optimized", "[optimizer]")
+{
+  auto program = optimized("procedimiento(n) { regresa n * (2 * 3); }");
+  auto *function = static_cast<Function *>(last_expression(*program));
+  auto *return_statement =
+      static_cast<ReturnStatement *>(function->body->statements.front());
+  auto *infix = static_cast<Infix *>(return_statement->return_value);
+  REQUIRE(infix->right->to_string() == "6");
+}
+
+TEST_CASE("Calls to small procedimientos are inlined", "[optimizer]")
+{
+  const string doble = "variable doble = procedimiento(x) { x * 2 };";
+  auto program = optimized(doble + "doble(21)");
+  auto *call = static_cast<Call *>(last_expression(*program));
+  REQUIRE(call->inlined != nullptr);
+  REQUIRE(call->inlined->to_string() == "42");
+
+  program = optimized(doble + "variable y = 3; doble(y + 1)");
+  call = static_cast<Call *>(last_expression(*program));
+  REQUIRE(call->inlined != nullptr);
+  REQUIRE(call->inlined->to_string() == "((y + 1) * 2)");
+
+  program = optimized("variable mayor = procedimiento(a, b) {"
+                      "  si (a > b) { a } si_no { b } };"
+                      "variable y = 3; mayor(y, 4)");
+  call = static_cast<Call *>(last_expression(*program));
+  REQUIRE(call->inlined != nullptr);
+  REQUIRE(call->inlined->type() == Node::If);
+}
+
+TEST_CASE("Only stable, small and pure calls are inlined", "[optimizer]")
+{
+  vector<string> tests{
+      "variable doble = procedimiento(x) { x * 2 }; doble = 1; doble(1)",
+      "variable doble = procedimiento(x) { x * 2 };"
+      "variable f = procedimiento() { variable doble = 3; };"
+      "doble(1)",
+      "variable doble = procedimiento(x) { x * 2 }; doble(doble(1))",
+      "variable doble = procedimiento(x) { x * 2 }; doble(1, 2)",
+      "variable cuadrado = procedimiento(x) { x * x };"
+      "variable y = 3; cuadrado(y + 1)",
+      "variable k = 2; variable por_k = procedimiento(x) { x * k }; por_k(1)",
+      "variable f = procedimiento(x) { variable y = x; y }; f(1)",
+      "variable f = procedimiento(x) { longitud(x) }; f(\"a\")",
+      "variable f = procedimiento(x) {"
+      "  x * x + x * x + x * x + x * x + x * x };"
+      "f(1)"};
+
+  for (auto &test : tests) {
+    INFO(test);
+    auto program = optimized(test);
+    auto *call = static_cast<Call *>(last_expression(*program));
+    REQUIRE(call->inlined == nullptr);
+  }
+}
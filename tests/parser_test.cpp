@@ -5,6 +5,7 @@
 #include <array>
 #include <cstddef>
 #include <iostream>
+#include <map>
 #include <string>
 #include <tuple>
 #include <vector>
@@ -50,6 +51,8 @@ void test_infix_expression(Expression *expression, const T &expected_left,
   auto *infix = static_cast<Infix *>(expression);
   test_literal(infix->left, expected_left);
   REQUIRE(infix->operatr == expected_operator);
+  REQUIRE(getNameForValue(ast::operators_enums_strings, infix->op) ==
+          expected_operator);
   test_literal(infix->right, expected_right);
 }
 
@@ -59,10 +62,11 @@ TEST_CASE("Parse program", "[parser]")
   Lexer lexer(str);
   Parser parser(lexer);
   Program program(parser.parse_program());
-  Program expected_program{vector<Statement *>{
-      new LetStatement(Token(TokenType::LET, "variable", 1, 8),
-                       new Identifier(Token(TokenType::IDENT, "x"), "x"),
-                       new Expression(Token(TokenType::INT, "5")))}};
+  Arena arena;
+  Program expected_program{vector<Statement *>{arena.make<LetStatement>(
+      Token(TokenType::LET, "variable", 1, 8),
+      arena.make<Identifier>(Token(TokenType::IDENT, "x"), "x"),
+      arena.make<Expression>(Token(TokenType::INT, "5")))}};
 
   REQUIRE(program == expected_program);
 }
@@ -120,6 +124,28 @@ TEST_CASE("Parse errors", "[parser]")
   REQUIRE(parser.errors().size() == 1);
 }
 
+TEST_CASE("Tokens that can't start an expression", "[parser]")
+{
+  vector<tuple<string, string>> tests{
+      {"variable x = ;",
+       "No se encontró ninguna función para parsear ; cerca de la línea 1\n"},
+      {"5 +\n*",
+       "No se encontró ninguna función para parsear * cerca de la línea 2\n"},
+      {"99999999999999999999",
+       "No se pudo parsear 99999999999999999999 como entero cerca de la "
+       "línea 1\n"}};
+
+  for (auto &test : tests) {
+    INFO(get<0>(test));
+    Lexer lexer(get<0>(test));
+    Parser parser(lexer);
+    Program program(parser.parse_program());
+
+    REQUIRE(parser.errors().size() == 1);
+    REQUIRE(parser.errors().front() == get<1>(test));
+  }
+}
+
 TEST_CASE("Return statement", "[parser]")
 {
   string str = "regresa 5; regresa foo; regresa verdadero; regresa falso;";
@@ -172,6 +198,20 @@ TEST_CASE("Integer expression", "[parser]")
   test_literal(expression_statement->expression, 5);
 }
 
+TEST_CASE("Integers wider than 32 bits", "[parser]")
+{
+  Lexer lexer("99999999999;");
+  Parser parser(lexer);
+  Program program(parser.parse_program());
+
+  test_program_statements(parser, program);
+
+  auto *integer = static_cast<Integer *>(
+      static_cast<ExpressionStatement *>(program.statements.at(0))
+          ->expression);
+  REQUIRE(integer->value == 99999999999UL);
+}
+
 TEST_CASE("Prefix expression", "[parser]")
 {
   string str = "!5; -15; !verdadero;";
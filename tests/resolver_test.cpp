@@ -0,0 +1,103 @@
+#include "../src/interpreter/ast.h"
+#include "../src/interpreter/lexer.h"
+#include "../src/interpreter/parser.h"
+#include "../src/interpreter/resolver.h"
+#include "catch2/catch_test_macros.hpp"
+#include <string>
+using namespace std;
+using namespace ast;
+
+auto last_expression(Program &program) -> Expression *
+{
+  auto *statement = program.statements.back();
+  REQUIRE(statement->type() == Node::ExpressionStatement);
+  return static_cast<ExpressionStatement *>(statement)->expression;
+}
+
+TEST_CASE("Globals get a slot each", "[resolver]")
+{
+  Lexer lexer("variable a = 1; variable b = 2; b");
+  Parser parser(lexer);
+  Program program(parser.parse_program());
+  Scope globals;
+  Resolver resolver;
+  resolver.resolve_program(&program, globals);
+
+  auto *ident = static_cast<Identifier *>(last_expression(program));
+  REQUIRE(ident->depth == 0);
+  REQUIRE(ident->slot == 1);
+  REQUIRE(globals.size() == 2);
+}
+
+TEST_CASE("Closures address outer scopes by depth", "[resolver]")
+{
+  Lexer lexer("variable sumador = procedimiento(x) {"
+              "  procedimiento(y) { x + y } };"
+              "sumador");
+  Parser parser(lexer);
+  Program program(parser.parse_program());
+  Scope globals;
+  Resolver resolver;
+  resolver.resolve_program(&program, globals);
+
+  auto *let = static_cast<LetStatement *>(program.statements.front());
+  auto *outer = static_cast<Function *>(let->value);
+  auto *body = static_cast<ExpressionStatement *>(outer->body->statements[0]);
+  auto *inner = static_cast<Function *>(body->expression);
+  auto *sum = static_cast<ExpressionStatement *>(inner->body->statements[0]);
+  auto *infix = static_cast<Infix *>(sum->expression);
+
+  auto *x = static_cast<Identifier *>(infix->left);
+  auto *y = static_cast<Identifier *>(infix->right);
+  REQUIRE(x->depth == 1);
+  REQUIRE(x->slot == 0);
+  REQUIRE(y->depth == 0);
+  REQUIRE(y->slot == 0);
+}
+
+TEST_CASE("Unknown names become globals", "[resolver]")
+{
+  Lexer lexer("procedimiento() { longitud }");
+  Parser parser(lexer);
+  Program program(parser.parse_program());
+  Scope globals;
+  Resolver resolver;
+  resolver.resolve_program(&program, globals);
+
+  auto *function = static_cast<Function *>(last_expression(program));
+  auto *body =
+      static_cast<ExpressionStatement *>(function->body->statements[0]);
+  auto *ident = static_cast<Identifier *>(body->expression);
+  REQUIRE(ident->depth == 1);
+  REQUIRE(globals.find(intern_symbol("longitud")) == ident->slot);
+}
+
+TEST_CASE("Only regresa f() outside of loops is a tail call", "[resolver]")
+{
+  Lexer lexer("procedimiento(n) {"
+              "  mientras (n > 0) { regresa f(n); }"
+              "  si (n == 0) { regresa 1 + f(n); }"
+              "  regresa f(n - 1);"
+              "}");
+  Parser parser(lexer);
+  Program program(parser.parse_program());
+  Scope globals;
+  Resolver resolver;
+  resolver.resolve_program(&program, globals);
+
+  auto *function = static_cast<Function *>(last_expression(program));
+  const auto &statements = function->body->statements;
+  auto *loop = static_cast<LoopStatement *>(statements.at(0));
+  auto *in_loop = static_cast<ReturnStatement *>(loop->repeat->statements[0]);
+  auto *if_statement = static_cast<ExpressionStatement *>(statements.at(1));
+  auto *consequence = static_cast<If *>(if_statement->expression)->consequence;
+  auto *not_a_call =
+      static_cast<ReturnStatement *>(consequence->statements[0]);
+  auto *tail = static_cast<ReturnStatement *>(statements.at(2));
+
+  REQUIRE_FALSE(in_loop->tail_call);
+  REQUIRE_FALSE(not_a_call->tail_call);
+  REQUIRE(tail->tail_call);
+  REQUIRE_FALSE(function->scope.is_captured());
+  REQUIRE(globals.is_captured());
+}
@@ -0,0 +1,248 @@
+#include "../src/interpreter/ast.h"
+#include "../src/interpreter/evaluator.h"
+#include "../src/interpreter/lexer.h"
+#include "../src/interpreter/object.h"
+#include "../src/interpreter/parser.h"
+#include "../src/interpreter/vm.h"
+#include "catch2/catch_test_macros.hpp"
+#include <memory>
+#include <string>
+#include <tuple>
+#include <vector>
+using namespace std;
+using ast::Program;
+using obj::Value;
+
+auto run_vm(const string &str, obj::Environment *env = nullptr) -> Value
+{
+  Lexer lexer(str);
+  Parser parser(lexer);
+  Program program(parser.parse_program());
+  REQUIRE(parser.errors().empty());
+
+  VM machine;
+  Value evaluated;
+  if (env == nullptr) {
+    auto temp_env = make_unique<obj::Environment>();
+    evaluated = machine.run(&program, temp_env.get());
+  }
+  else {
+    evaluated = machine.run(&program, env);
+  }
+
+  return evaluated;
+}
+
+auto run_tree_walker(const string &str) -> string
+{
+  Lexer lexer(str);
+  Parser parser(lexer);
+  Program program(parser.parse_program());
+  auto env = make_unique<obj::Environment>();
+  return evaluate(&program, env.get()).inspect();
+}
+
+TEST_CASE("VM integer arithmetic", "[vm]")
+{
+  vector<tuple<string, int>> tests{{"5", 5},
+                                   {"-10", -10},
+                                   {"5 + 5", 10},
+                                   {"5 - 10", -5},
+                                   {"2 * 2 * 2 * 2", 16},
+                                   {"2 * (5 - 3)", 4},
+                                   {"50 / 2 * 2 + 10", 60},
+                                   {"5 / 2", 2}};
+
+  for (auto &test : tests) {
+    INFO(get<0>(test));
+    auto evaluated = run_vm(get<0>(test));
+    REQUIRE(evaluated.is_integer());
+    REQUIRE(evaluated.as_integer() == get<1>(test));
+  }
+}
+
+TEST_CASE("VM booleans and conditionals", "[vm]")
+{
+  vector<tuple<string, string>> tests{
+      {"1 < 2", "verdadero"},
+      {"(1 > 2) == falso", "verdadero"},
+      {"nulo != 1", "verdadero"},
+      {"!!5", "verdadero"},
+      {"!nulo", "verdadero"},
+      {R"("a" == "a")", "verdadero"},
+      {"si (1 > 2) { 10 }", "nulo"},
+      {"si (1 < 2) { 10 } si_no { 20 }", "10"},
+      {"si (1 > 2) { 10 } si_no { 20 }", "20"},
+      {"9; regresa 3 * 6; 9;", "18"}};
+
+  for (auto &test : tests) {
+    INFO(get<0>(test));
+    REQUIRE(run_vm(get<0>(test)).inspect() == get<1>(test));
+  }
+}
+
+TEST_CASE("VM loops", "[vm]")
+{
+  vector<tuple<string, string>> tests{
+      {"variable i = 0; mientras (i < 10) { i = i + 1; } i", "10"},
+      {"variable i = 0; mientras (i < 5) { i = i + 1; regresa 1; } i", "5"},
+      {"variable f = procedimiento(n) {                          \
+            variable total = 0;                                 \
+            mientras (n > 0) { total = total + n; n = n - 1; }  \
+            regresa total;                                      \
+        }; f(100)",
+       "5050"}};
+
+  for (auto &test : tests) {
+    INFO(get<0>(test));
+    REQUIRE(run_vm(get<0>(test)).inspect() == get<1>(test));
+  }
+}
+
+TEST_CASE("VM functions and closures", "[vm]")
+{
+  vector<tuple<string, string>> tests{
+      {"variable identidad = procedimiento(x) { x }; identidad(5);", "5"},
+      {"variable suma = procedimiento(x, y) { regresa x + y; };    \
+            suma(5 + 5, suma(10, 10));",
+       "30"},
+      {"procedimiento(x) { x }(5)", "5"},
+      {"variable sumador = procedimiento(x) {                      \
+            regresa procedimiento(y) { regresa x + y; };            \
+        };                                                          \
+        variable suma_dos = sumador(2); suma_dos(5);",
+       "7"},
+      {"variable factorial = procedimiento(n) {                    \
+            si (n > 1) { regresa n * factorial(n - 1); }            \
+            si_no { regresa 1; }                                    \
+        }; factorial(10);",
+       "3628800"},
+      {R"(longitud("cuatro"))", "6"}};
+
+  for (auto &test : tests) {
+    INFO(get<0>(test));
+    REQUIRE(run_vm(get<0>(test)).inspect() == get<1>(test));
+  }
+}
+
+TEST_CASE("VM matches the tree-walking evaluator", "[vm]")
+{
+  vector<string> tests{
+      "5 + verdadero; 9;",
+      "-verdadero",
+      "si (10 > 7) {\n regresa verdadero + falso;\n }",
+      R"("foo" - "bar";)",
+      "longitud(1);",
+      R"(longitud("uno", "dos");)",
+      "variable f = procedimiento(x) { x }; f(1, 2)",
+      "variable a = 5; a(1)",
+      "variable x = 1;"
+      "variable f = procedimiento() { variable y = x; variable x = 5; y };"
+      "f()",
+      "variable f = procedimiento() { g() };"
+      "variable g = procedimiento() { 7 }; f()",
+      "variable f = procedimiento() { regresa g(1); };"
+      "variable g = procedimiento(x, y) { x }; f()",
+      "variable f = procedimiento() { regresa 5(1); }; f()",
+      "variable x = 7;\n x / (3 - 3)",
+      "variable f = procedimiento(n) { regresa 10 / n; }; f(0)",
+      "si (2 * 3 == 6) { \"seis\" } si_no { 1 / 0 }",
+      R"(variable saludo = procedimiento(nombre) {
+           regresa "Hola " + nombre + "!";
+         }
+         saludo("David"))",
+      R"(variable fibonacci = procedimiento(numero) {
+           variable a = 0;
+           variable b = 1;
+           variable c = 1;
+           variable secuencia = "";
+           variable contador = 1;
+           mientras (contador < numero) {
+             c = a + b;
+             secuencia = secuencia + entero_a_cadena(c) + " ";
+             a = b;
+             b = c;
+             contador = contador + 1;
+           }
+           regresa secuencia;
+         }
+         fibonacci(15);)"};
+
+  for (auto &test : tests) {
+    INFO(test);
+    REQUIRE(run_vm(test).inspect() == run_tree_walker(test));
+  }
+}
+
+TEST_CASE("VM keeps the environment between runs", "[vm]")
+{
+  auto env = make_unique<obj::Environment>();
+  ast::Programs_Guard guard;
+  VM machine;
+  vector<string> lines{
+      "variable a = 10; variable doble = procedimiento(x) { 2 * x };",
+      "doble(a)"};
+
+  Value evaluated;
+  for (const auto &line : lines) {
+    Lexer lexer(line);
+    Parser parser(lexer);
+    auto statements = parser.parse_program();
+    auto *program = guard.new_program(statements, parser.take_arena());
+    evaluated = machine.run(program, env.get());
+  }
+
+  REQUIRE(evaluated.inspect() == "20");
+}
+
+TEST_CASE("VM counts loop back edges", "[vm]")
+{
+  Lexer lexer("variable i = 0; mientras (i < 1000) { i = i + 1; } i");
+  Parser parser(lexer);
+  Program program(parser.parse_program());
+  auto env = make_unique<obj::Environment>();
+  VM machine;
+
+  REQUIRE(machine.run(&program, env.get()).inspect() == "1000");
+  auto *loop = static_cast<ast::LoopStatement *>(program.statements.at(1));
+  REQUIRE(loop->back_edges == 1000);
+}
+
+TEST_CASE("VM recursion is not bound by the native stack", "[vm]")
+{
+  auto evaluated =
+      run_vm("variable f = procedimiento(n) {"
+             "  si (n == 0) { regresa 0; } regresa 1 + f(n - 1); };"
+             "f(100000)");
+  REQUIRE(evaluated.is_integer());
+  REQUIRE(evaluated.as_integer() == 100000);
+
+  Lexer lexer("variable f = procedimiento(n) {"
+              "  variable r = f(n + 1); regresa r; }; f(0)");
+  Parser parser(lexer);
+  Program program(parser.parse_program());
+  auto env = make_unique<obj::Environment>();
+  VM machine;
+  machine.set_max_depth(1000);
+
+  evaluated = machine.run(&program, env.get());
+  REQUIRE(evaluated.type() == obj::ObjectType::ERROR);
+  REQUIRE(static_cast<obj::Error *>(evaluated.as_object())->message ==
+          "Desbordamiento de pila cerca de la línea 1, se superaron 1000 "
+          "llamadas anidadas");
+}
+
+TEST_CASE("VM tail calls reuse the frame", "[vm]")
+{
+  Lexer lexer("variable ciclo = procedimiento(n, acc) {"
+              "  si (n == 0) { regresa acc; }"
+              "  regresa ciclo(n - 1, acc + 2); };"
+              "ciclo(100000, 0)");
+  Parser parser(lexer);
+  Program program(parser.parse_program());
+  auto env = make_unique<obj::Environment>();
+  VM machine;
+  machine.set_max_depth(10);
+
+  REQUIRE(machine.run(&program, env.get()).inspect() == "200000");
+}